@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <limits>
+
+namespace auxiliary {
+/*** Snapshot of counters collected by bimap_stats ***/
+struct bimap_stats_snapshot {
+  // bucket i holds searches whose path length l satisfies std::bit_width(l) == i
+  static constexpr std::size_t HISTOGRAM_SIZE = std::numeric_limits<std::size_t>::digits + 1;
+
+  std::size_t comparisons = 0;
+  std::size_t searches = 0;
+  std::size_t total_depth = 0;
+  std::size_t max_depth = 0;
+  std::size_t allocations = 0;
+  std::size_t deallocations = 0;
+  std::array<std::size_t, HISTOGRAM_SIZE> depth_histogram{};
+
+  double average_depth() const {
+    return searches == 0 ? 0.0 : static_cast<double>(total_depth) / static_cast<double>(searches);
+  }
+};
+} // namespace auxiliary
+
+/*** Instrumentation policies for bimap ***/
+struct bimap_no_stats {
+  static constexpr bool enabled = false;
+
+  void on_compare() noexcept {}
+
+  void on_search(std::size_t /* depth */) noexcept {}
+
+  void on_allocate() noexcept {}
+
+  void on_deallocate() noexcept {}
+};
+
+struct bimap_stats {
+  static constexpr bool enabled = true;
+
+private:
+  auxiliary::bimap_stats_snapshot data;
+
+public:
+  void on_compare() noexcept {
+    data.comparisons++;
+  }
+
+  void on_search(std::size_t depth) noexcept {
+    data.searches++;
+    data.total_depth += depth;
+    if (depth > data.max_depth) {
+      data.max_depth = depth;
+    }
+    data.depth_histogram[std::bit_width(depth)]++;
+  }
+
+  void on_allocate() noexcept {
+    data.allocations++;
+  }
+
+  void on_deallocate() noexcept {
+    data.deallocations++;
+  }
+
+  const auxiliary::bimap_stats_snapshot& snapshot() const noexcept {
+    return data;
+  }
+
+  void reset() noexcept {
+    data = auxiliary::bimap_stats_snapshot();
+  }
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "bimap-stats.h"
 #include "map-basic.h"
 
 #include <cstddef>
@@ -10,20 +11,21 @@ template <
     typename Left,
     typename Right,
     typename CompareLeft = std::less<Left>,
-    typename CompareRight = std::less<Right>>
+    typename CompareRight = std::less<Right>,
+    typename Stats = bimap_no_stats>
 class bimap
-    : private auxiliary::map_basic<Left, Right, CompareLeft, CompareRight, auxiliary::left_tag>
-    , private auxiliary::map_basic<Right, Left, CompareRight, CompareLeft, auxiliary::right_tag> {
+    : private auxiliary::map_basic<Left, Right, CompareLeft, CompareRight, auxiliary::left_tag, Stats>
+    , private auxiliary::map_basic<Right, Left, CompareRight, CompareLeft, auxiliary::right_tag, Stats> {
 public:
   using left_t = Left;
   using right_t = Right;
 
 private:
   // using map_prototype = auxiliary::map_prototype;
-  using left_map_t = auxiliary::map_basic<left_t, right_t, CompareLeft, CompareRight, auxiliary::left_tag>;
-  using right_map_t = auxiliary::map_basic<right_t, left_t, CompareRight, CompareLeft, auxiliary::right_tag>;
+  using left_map_t = auxiliary::map_basic<left_t, right_t, CompareLeft, CompareRight, auxiliary::left_tag, Stats>;
+  using right_map_t = auxiliary::map_basic<right_t, left_t, CompareRight, CompareLeft, auxiliary::right_tag, Stats>;
 
-  template <typename, typename, typename, typename, typename>
+  template <typename, typename, typename, typename, typename, typename>
   friend class auxiliary::map_basic;
 
   using node_left_t = auxiliary::node_tagged<auxiliary::left_tag>;
@@ -37,6 +39,12 @@ public:
 private:
   auxiliary::node_empty_mutual sentinel;
   std::size_t count = 0;
+#ifdef _MSC_VER
+  [[msvc::no_unique_address]]
+#else
+  [[no_unique_address]]
+#endif
+  mutable Stats stats_policy;
 
   left_map_t& as_left() {
     return static_cast<left_map_t&>(*this);
@@ -79,7 +87,8 @@ public:
   bimap(bimap&& other)
       : left_map_t(std::move(other))
       , right_map_t(std::move(other))
-      , sentinel(std::move(other.sentinel)) {
+      , sentinel(std::move(other.sentinel))
+      , stats_policy(std::exchange(other.stats_policy, Stats())) {
     count = std::exchange(other.count, 0);
   }
 
@@ -101,6 +110,7 @@ public:
     left_map_t::swap(other);
     right_map_t::swap(other);
     std::swap(count, other.count);
+    std::swap(stats_policy, other.stats_policy);
   }
 
   friend void swap(bimap& lhs, bimap& rhs) noexcept {
@@ -121,6 +131,7 @@ private:
     node_mutual_t* node = nullptr;
     // try {
     node = new node_mutual_t(std::forward<T1>(left), std::forward<T2>(right));
+    stats_policy.on_allocate();
     // } catch (std::bad_alloc&) {
     //   throw;
     // } catch (...) {
@@ -239,6 +250,18 @@ public:
     return count;
   }
 
+  auxiliary::bimap_stats_snapshot stats() const
+    requires (Stats::enabled)
+  {
+    return stats_policy.snapshot();
+  }
+
+  void reset_stats()
+    requires (Stats::enabled)
+  {
+    stats_policy.reset();
+  }
+
   friend bool operator==(const bimap& lhs, const bimap& rhs) {
     bool res = lhs.size() == rhs.size();
 
@@ -10,10 +10,10 @@ using opposite_tag = std::conditional_t<std::is_same_v<Tag, left_tag>, right_tag
 
 template <typename T, typename OT, typename Tag>
 class iterator_map {
-  template <typename, typename, typename, typename>
+  template <typename, typename, typename, typename, typename>
   friend class ::bimap;
 
-  template <typename, typename, typename, typename, typename>
+  template <typename, typename, typename, typename, typename, typename>
   friend class map_basic;
 
 public:
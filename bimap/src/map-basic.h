@@ -2,21 +2,22 @@
 
 #include "iterator-map.h"
 
+#include <cstddef>
 #include <stdexcept>
 
 namespace auxiliary {
 
-template <typename T, typename OT, typename Cmp, typename OCmp, typename Tag>
+template <typename T, typename OT, typename Cmp, typename OCmp, typename Tag, typename Stats>
 class map_basic : public Cmp {
 protected:
   using iterator = iterator_map<T, OT, Tag>;
 
 private:
   using traits = bimap_traits<T, OT, Tag>;
-  using other_map_t = typename traits::template other_map_t<Cmp, OCmp>;
-  using map_t = typename traits::template map_t<Cmp, OCmp>;
+  using other_map_t = typename traits::template other_map_t<Cmp, OCmp, Stats>;
+  using map_t = typename traits::template map_t<Cmp, OCmp, Stats>;
 
-  template <typename, typename, typename, typename, typename>
+  template <typename, typename, typename, typename, typename, typename>
   friend class map_basic;
 
   // traits::node_tagged_t sentinel;
@@ -45,6 +46,10 @@ private:
     return as_base();
   }
 
+  Stats& stats_policy() const {
+    return as_base().stats_policy;
+  }
+
 protected:
   map_basic(Cmp comparator)
       : Cmp(std::move(comparator)) {
@@ -146,6 +151,7 @@ protected:
     as_other().remove_node(it.flip());
     iterator res = remove_node(it);
     delete static_cast<traits::node_mutual_t*>(static_cast<traits::node_tagged_t*>(it.ptr));
+    stats_policy().on_deallocate();
     as_base().count--;
 
     return res;
@@ -191,6 +197,7 @@ protected:
       } else {
         node = new traits::node_mutual_t(std::move(delem), key);
       }
+      stats_policy().on_allocate();
       if (del) {
         as_other().erase(ir++);
       }
@@ -215,8 +222,11 @@ protected:
   iterator bound(const T& key, const BoundComparator& cmp) const {
     node_base* cur = sentinel().left; // root
     node_base* potential = nullptr;
+    std::size_t depth = 0;
 
     while (cur != nullptr && cur != &sentinel()) {
+      stats_policy().on_compare();
+      depth++;
       if (cmp(key, as_elem(cur))) {
         potential = cur;
         cur = cur->left;
@@ -224,6 +234,7 @@ protected:
         cur = cur->right;
       }
     }
+    stats_policy().on_search(depth);
     return potential == nullptr ? end() : potential;
   }
 
@@ -3,7 +3,7 @@
 #include <type_traits>
 #include <utility>
 
-template <typename, typename, typename, typename>
+template <typename, typename, typename, typename, typename>
 class bimap;
 
 namespace auxiliary {
@@ -120,7 +120,7 @@ struct node_mutual
       , node_element<R, right_tag>(std::forward<RF>(r)) {}
 };
 
-template <typename, typename, typename, typename, typename>
+template <typename, typename, typename, typename, typename, typename>
 class map_basic;
 
 template <typename, typename, typename>
@@ -140,11 +140,11 @@ struct bimap_traits<T, OT, left_tag> {
   using other_iterator = iterator_map<OT, T, right_tag>;
   using other_tag = right_tag;
 
-  template <typename Cmp, typename OCmp>
-  using other_map_t = map_basic<OT, T, OCmp, Cmp, right_tag>;
+  template <typename Cmp, typename OCmp, typename Stats>
+  using other_map_t = map_basic<OT, T, OCmp, Cmp, right_tag, Stats>;
 
-  template <typename Cmp, typename OCmp>
-  using map_t = ::bimap<T, OT, Cmp, OCmp>;
+  template <typename Cmp, typename OCmp, typename Stats>
+  using map_t = ::bimap<T, OT, Cmp, OCmp, Stats>;
 };
 
 template <typename T, typename OT>
@@ -157,10 +157,10 @@ struct bimap_traits<T, OT, right_tag> {
   using other_iterator = iterator_map<OT, T, left_tag>;
   using other_tag = left_tag;
 
-  template <typename Cmp, typename OCmp>
-  using other_map_t = map_basic<OT, T, OCmp, Cmp, left_tag>;
+  template <typename Cmp, typename OCmp, typename Stats>
+  using other_map_t = map_basic<OT, T, OCmp, Cmp, left_tag, Stats>;
 
-  template <typename Cmp, typename OCmp>
-  using map_t = ::bimap<OT, T, OCmp, Cmp>;
+  template <typename Cmp, typename OCmp, typename Stats>
+  using map_t = ::bimap<OT, T, OCmp, Cmp, Stats>;
 };
 } // namespace auxiliary
@@ -2,7 +2,7 @@
 #define _main main
 #endif
 
-#include "test.h"
+#include "../../common/test.h"
 
 #include "bimap.h"
 
@@ -269,6 +269,27 @@ void test_simple_2() {
   _check(b.end_left() == b.end_right().flip());
 }
 
+void test_stats() {
+  using bmp = bimap<int, int, std::less<int>, std::less<int>, bimap_stats>;
+  bmp t;
+
+  for (int i = 0; i < 16; i++) {
+    t.insert(i, -i);
+  }
+  _check(t.stats().allocations == 16);
+  _check(t.stats().max_depth == 15);
+
+  t.reset_stats();
+  _check(t.find_left(15) != t.end_left());
+  _check(t.stats().searches == 1);
+  _check(t.stats().comparisons == 16);
+  _check(t.stats().depth_histogram[std::bit_width(16u)] == 1);
+  _check(t.stats().average_depth() == 16.0);
+
+  t.erase_left(3);
+  _check(t.stats().deallocations == 1);
+}
+
 int _main() {
   _run(test_static);
   _run(test_empty);
@@ -280,5 +301,6 @@ int _main() {
   _run(test_simple);
   _run(test_copy);
   _run(test_simple_2);
+  _run(test_stats);
   return 0;
 }
\ No newline at end of file
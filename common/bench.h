@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+
+// Scaffolding of the bench.cpp files, which print one CSV row per measurement.
+namespace bench {
+template <typename T>
+void keep(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// average time of one call of body, repeated until roughly 20ms have passed
+template <typename Body>
+double measure(Body body) {
+  using clock = std::chrono::steady_clock;
+
+  std::size_t iterations = 1;
+
+  for (;;) {
+    auto start = clock::now();
+    for (std::size_t i = 0; i < iterations; i++) {
+      body();
+    }
+    std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+
+    if (elapsed.count() > 2e7 || iterations >= (std::size_t(1) << 24)) {
+      return elapsed.count() / static_cast<double>(iterations);
+    }
+    iterations *= 2;
+  }
+}
+
+// the fields of one row, the time goes last
+template <typename... Fields>
+void report(const Fields&... fields) {
+  const char* separator = "";
+
+  ((std::cout << separator << fields, separator = ","), ...);
+  std::cout << '\n';
+}
+} // namespace bench
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "shared-ptr.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+
+namespace auxiliary {
+// Count of a node of atomic_shared_ptr, 0 while the node is stored. A reader that finds its
+// node swapped out takes its reference off here, possibly below zero; the writer that swapped
+// it out adds the readers it took from the word. Whoever brings it to 0 frees the node.
+class split_count {
+private:
+  std::atomic<std::ptrdiff_t> count = 0;
+
+public:
+  split_count() = default;
+  split_count(const split_count&) = delete;
+  split_count& operator=(const split_count&) = delete;
+
+  // returns true when the count drops to 0
+  bool add(std::ptrdiff_t n) noexcept {
+    return count.fetch_add(n, std::memory_order_acq_rel) + n == 0;
+  }
+
+  bool decrement() noexcept {
+    return add(-1);
+  }
+};
+} // namespace auxiliary
+
+// Atomic holder of a shared_ptr with split reference counting. The value lives in a node,
+// a make_shared-like control block of shared_ptr<T>; one word packs the node pointer with a
+// local count of readers that are copying out of it. A reader takes a local reference with
+// one CAS, copies the shared_ptr and gives the reference back through the word, or through the
+// node's split_count once a writer has swapped the node out, so readers never lock.
+// Every operation is acq_rel. The pointer takes the low 48 bits of the word.
+template <typename T>
+class atomic_shared_ptr {
+private:
+  using value_type = shared_ptr<T>;
+  using node_type = auxiliary::control_block_obj<value_type, auxiliary::split_count, std::allocator<value_type>>;
+
+  static_assert(sizeof(std::uintptr_t) == 8, "atomic_shared_ptr keeps the reader count in the pointer's high bits");
+
+  static constexpr std::uintptr_t ONE_LOCAL = std::uintptr_t(1) << 48;
+  static constexpr std::uintptr_t POINTER_MASK = ONE_LOCAL - 1;
+  static constexpr std::size_t MAX_LOCAL = (std::size_t(1) << 16) - 1;
+
+  // every store makes a new node and a null word never has local references, so a word
+  // can't come back while a reader still counts on it
+  mutable std::atomic<std::uintptr_t> word;
+
+  static node_type* node_of(std::uintptr_t word) noexcept {
+    return reinterpret_cast<node_type*>(word & POINTER_MASK);
+  }
+
+  static std::size_t local_of(std::uintptr_t word) noexcept {
+    return word >> 48;
+  }
+
+  static void free_node(node_type* node) noexcept {
+    node_type::release(node, auxiliary::release_step::both);
+  }
+
+  static std::uintptr_t make_word(value_type&& desired) {
+    if (!desired.control_block && !desired.ptr) {
+      return 0;
+    }
+
+    node_type* node = auxiliary::allocate_control_block<node_type>(std::allocator<value_type>(), std::move(desired));
+    auto res = reinterpret_cast<std::uintptr_t>(node);
+
+    // e.g. with 5-level paging, the reader count would overwrite the pointer
+    if ((res & ~POINTER_MASK) != 0) {
+      free_node(node);
+      throw std::bad_alloc();
+    }
+    return res;
+  }
+
+  // returns the current word after taking a local reference to its node, if there is one
+  std::uintptr_t acquire_local() const noexcept {
+    std::uintptr_t current = word.load(std::memory_order_acquire);
+
+    while (node_of(current)) {
+      // the count would carry into the pointer, wait for a reader to leave
+      if (local_of(current) == MAX_LOCAL) {
+        std::this_thread::yield();
+        current = word.load(std::memory_order_acquire);
+        continue;
+      }
+      if (word.compare_exchange_weak(current, current + ONE_LOCAL, std::memory_order_acquire)) {
+        break;
+      }
+    }
+    return current;
+  }
+
+  void release_local(node_type* node) const noexcept {
+    std::uintptr_t current = word.load(std::memory_order_relaxed);
+
+    while (node_of(current) == node) {
+      if (word.compare_exchange_weak(current, current - ONE_LOCAL, std::memory_order_acq_rel)) {
+        return;
+      }
+    }
+    // the writer that swapped the node out counts this reference in the node
+    if (node->count.decrement()) {
+      free_node(node);
+    }
+  }
+
+  // old was swapped out by the caller, its readers give their references back to the node;
+  // released is how many of them the caller itself gives back at once
+  static void retire(std::uintptr_t old, std::size_t released = 0) noexcept {
+    node_type* node = node_of(old);
+
+    if (node && node->count.add(static_cast<std::ptrdiff_t>(local_of(old) - released))) {
+      free_node(node);
+    }
+  }
+
+  static bool equivalent(const value_type& lhs, const value_type& rhs) noexcept {
+    return lhs.ptr == rhs.ptr && lhs.control_block == rhs.control_block;
+  }
+
+public:
+  static constexpr bool is_always_lock_free = true;
+
+  atomic_shared_ptr() noexcept
+      : word(0) {}
+
+  atomic_shared_ptr(std::nullptr_t) noexcept
+      : atomic_shared_ptr() {}
+
+  atomic_shared_ptr(value_type desired)
+      : word(make_word(std::move(desired))) {}
+
+  atomic_shared_ptr(const atomic_shared_ptr&) = delete;
+  atomic_shared_ptr& operator=(const atomic_shared_ptr&) = delete;
+
+  bool is_lock_free() const noexcept {
+    return true;
+  }
+
+  value_type load() const noexcept {
+    std::uintptr_t current = acquire_local();
+    node_type* node = node_of(current);
+
+    if (!node) {
+      return value_type();
+    }
+    value_type res = node->obj;
+    release_local(node);
+    return res;
+  }
+
+  operator value_type() const noexcept {
+    return load();
+  }
+
+  void store(value_type desired) {
+    retire(word.exchange(make_word(std::move(desired)), std::memory_order_acq_rel));
+  }
+
+  atomic_shared_ptr& operator=(value_type desired) {
+    store(std::move(desired));
+    return *this;
+  }
+
+  value_type exchange(value_type desired) {
+    std::uintptr_t old = word.exchange(make_word(std::move(desired)), std::memory_order_acq_rel);
+    value_type res = node_of(old) ? node_of(old)->obj : value_type();
+
+    retire(old);
+    return res;
+  }
+
+  // equal means the same pointer and the same owner; on failure expected gets the current value
+  bool compare_exchange_strong(value_type& expected, value_type desired) {
+    std::uintptr_t fresh = make_word(std::move(desired));
+
+    for (;;) {
+      std::uintptr_t current = acquire_local();
+      node_type* node = node_of(current);
+      value_type snapshot = node ? node->obj : value_type();
+
+      if (!equivalent(snapshot, expected)) {
+        if (node) {
+          release_local(node);
+        }
+        expected = std::move(snapshot);
+        retire(fresh);
+        return false;
+      }
+
+      // our own local reference, if any, is part of current and is retired with the node
+      current += node ? ONE_LOCAL : 0;
+      while (node_of(current) == node) {
+        if (word.compare_exchange_weak(current, fresh, std::memory_order_acq_rel)) {
+          retire(current, 1);
+          return true;
+        }
+      }
+      // another writer swapped the node out and counts our reference in it
+      if (node && node->count.decrement()) {
+        free_node(node);
+      }
+    }
+  }
+
+  bool compare_exchange_weak(value_type& expected, value_type desired) {
+    return compare_exchange_strong(expected, std::move(desired));
+  }
+
+  ~atomic_shared_ptr() {
+    retire(word.load(std::memory_order_relaxed));
+  }
+};
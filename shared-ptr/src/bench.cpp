@@ -0,0 +1,136 @@
+#ifdef __DEFINETELY_UNDEFINED_MACRO
+#define _main main
+#endif
+
+#include "../../common/bench.h"
+
+#include "atomic-shared-ptr.h"
+#include "control-block-pool.h"
+#include "intrusive-ptr.h"
+#include "shared-ptr.h"
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Prints one CSV row per (pointer, scenario, n):
+// pointer,scenario,n,ns_per_op
+
+namespace bench {
+struct counted_int : ref_counted<counted_int> {
+  int value;
+
+  explicit counted_int(int value)
+      : value(value) {}
+};
+
+template <typename Pointer, typename Make>
+void run_scenarios(std::string_view pointer, Make make) {
+  Pointer base = make();
+
+  // n copies of one pointer are made and then destroyed
+  for (std::size_t n : {1, 16, 1024}) {
+    std::vector<Pointer> copies;
+    copies.reserve(n);
+
+    report(pointer, "copy_destroy", n, measure([&] {
+      for (std::size_t i = 0; i < n; i++) {
+        copies.push_back(base);
+      }
+      keep(copies);
+      copies.clear();
+    }));
+  }
+
+  report(pointer, "make_destroy", 1, measure([&] {
+    Pointer p = make();
+    keep(p);
+  }));
+}
+
+// control block for an existing object, from the global allocator or the pool
+template <typename Pointer, typename Allocator>
+void run_wrap(std::string_view pointer) {
+  int object = 42;
+
+  report(pointer, "wrap_destroy", 1, measure([&] {
+    Pointer p(&object, [](int*) {}, Allocator());
+    keep(p);
+  }));
+}
+
+// shared_ptr guarded by a mutex, the baseline for atomic_shared_ptr
+class mutex_shared_ptr {
+private:
+  mutable std::mutex mutex;
+  shared_ptr<int> value;
+
+public:
+  shared_ptr<int> load() const {
+    std::lock_guard lock(mutex);
+    return value;
+  }
+
+  void store(shared_ptr<int> desired) {
+    std::lock_guard lock(mutex);
+    value.swap(desired);
+  }
+};
+
+// readers load the snapshot in a loop while one writer publishes new ones,
+// the time is per load of every reader
+template <typename Holder>
+void run_readers(std::string_view pointer) {
+  constexpr std::size_t LOADS = 200000;
+
+  for (std::size_t readers : {1, 2, 4, 8}) {
+    Holder holder;
+    holder.store(make_shared<int>(0));
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    std::atomic<std::size_t> running = readers;
+
+    for (std::size_t i = 0; i < readers; i++) {
+      threads.emplace_back([&] {
+        for (std::size_t j = 0; j < LOADS; j++) {
+          keep(holder.load());
+        }
+        running--;
+      });
+    }
+    for (int version = 1; running > 0; version++) {
+      holder.store(make_shared<int>(version));
+      std::this_thread::yield();
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    report(pointer, "load_readers", readers, elapsed.count() / static_cast<double>(LOADS));
+  }
+}
+} // namespace bench
+
+int _main() {
+  std::cout << "pointer,scenario,n,ns_per_op\n";
+  bench::run_scenarios<std::shared_ptr<int>>("std_shared_ptr", [] { return std::make_shared<int>(42); });
+  bench::run_scenarios<shared_ptr<int>>("shared_ptr", [] { return make_shared<int>(42); });
+  bench::run_scenarios<local_shared_ptr<int>>("local_shared_ptr", [] { return make_local_shared<int>(42); });
+  bench::run_scenarios<intrusive_ptr<bench::counted_int>>("intrusive_ptr", [] {
+    return make_intrusive<bench::counted_int>(42);
+  });
+  bench::run_wrap<std::shared_ptr<int>, std::allocator<int>>("std_shared_ptr");
+  bench::run_wrap<shared_ptr<int>, std::allocator<int>>("shared_ptr");
+  bench::run_wrap<shared_ptr<int>, pool_allocator<int>>("shared_ptr_pool");
+  bench::run_wrap<local_shared_ptr<int>, pool_allocator<int>>("local_shared_ptr_pool");
+  bench::run_readers<atomic_shared_ptr<int>>("atomic_shared_ptr");
+  bench::run_readers<bench::mutex_shared_ptr>("mutex_shared_ptr");
+  return 0;
+}
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+
+// Size-class pool for control blocks. Every thread keeps a free list per class and refills it
+// from a shared depot in batches; the depot gets memory from the global allocator in slabs.
+// Slabs are never returned, so after warmup allocation doesn't touch the global allocator.
+namespace auxiliary {
+struct pool_free_node {
+  pool_free_node* next;
+};
+
+struct pool_chain {
+  pool_free_node* head = nullptr;
+  std::size_t count = 0;
+
+  void push(pool_free_node* node) noexcept {
+    node->next = head;
+    head = node;
+    count++;
+  }
+
+  pool_free_node* pop() noexcept {
+    pool_free_node* node = head;
+    head = node->next;
+    count--;
+    return node;
+  }
+
+  // moves at most n nodes from the front of this chain to the front of other
+  void move_to(pool_chain& other, std::size_t n) noexcept {
+    for (; n > 0 && head; n--) {
+      other.push(pop());
+    }
+  }
+};
+
+// written by the owning thread only, so updates are a load and a store
+class pool_counter {
+private:
+  std::atomic<std::size_t> value = 0;
+
+public:
+  std::size_t load() const noexcept {
+    return value.load(std::memory_order_relaxed);
+  }
+
+  void increment() noexcept {
+    value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+};
+
+struct pool_thread_cache;
+
+class pool_depot {
+public:
+  static constexpr std::size_t GRANULARITY = 16;
+  static constexpr std::size_t CLASSES = 16;
+  static constexpr std::size_t MAX_SIZE = GRANULARITY * CLASSES;
+  static constexpr std::size_t BATCH = 32;
+
+private:
+  std::mutex mutex;
+  pool_chain free[CLASSES];
+  // intrusive list, so attaching a thread doesn't allocate
+  pool_thread_cache* caches = nullptr;
+  // counts of finished threads
+  std::size_t retired_hits = 0;
+  std::size_t retired_misses = 0;
+  std::atomic<std::size_t> slabs = 0;
+
+  pool_depot() = default;
+
+public:
+  // never destroyed, blocks may be released by static destructors; built in static storage,
+  // so getting the depot doesn't allocate and can't throw
+  static pool_depot& instance() noexcept {
+    alignas(pool_depot) static std::byte storage[sizeof(pool_depot)];
+    static pool_depot* depot = ::new (storage) pool_depot;
+    return *depot;
+  }
+
+  static std::size_t class_of(std::size_t bytes) noexcept {
+    return (bytes + GRANULARITY - 1) / GRANULARITY - 1;
+  }
+
+  // moves up to BATCH free blocks of the class to chain, carving a new slab if there are none
+  void refill(std::size_t size_class, pool_chain& chain) {
+    std::lock_guard lock(mutex);
+
+    if (!free[size_class].head) {
+      std::size_t block = (size_class + 1) * GRANULARITY;
+      auto* slab = static_cast<std::byte*>(::operator new(block * BATCH));
+
+      slabs.fetch_add(1, std::memory_order_relaxed);
+      for (std::size_t i = BATCH; i-- > 0;) {
+        free[size_class].push(reinterpret_cast<pool_free_node*>(slab + i * block));
+      }
+    }
+    free[size_class].move_to(chain, BATCH);
+  }
+
+  void give_back(std::size_t size_class, pool_chain& chain, std::size_t n) noexcept {
+    std::lock_guard lock(mutex);
+    chain.move_to(free[size_class], n);
+  }
+
+  void attach(pool_thread_cache* cache);
+
+  void detach(pool_thread_cache* cache) noexcept;
+
+  struct counts {
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t slabs;
+  };
+
+  counts collect() noexcept;
+};
+
+struct pool_thread_cache {
+  pool_chain free[pool_depot::CLASSES];
+  pool_counter hits;
+  pool_counter misses;
+  pool_thread_cache* prev = nullptr;
+  pool_thread_cache* next = nullptr;
+
+  pool_thread_cache() {
+    pool_depot::instance().attach(this);
+  }
+
+  pool_thread_cache(const pool_thread_cache&) = delete;
+  pool_thread_cache& operator=(const pool_thread_cache&) = delete;
+
+  ~pool_thread_cache() {
+    pool_depot::instance().detach(this);
+  }
+};
+
+inline void pool_depot::attach(pool_thread_cache* cache) {
+  std::lock_guard lock(mutex);
+
+  cache->next = caches;
+  if (caches) {
+    caches->prev = cache;
+  }
+  caches = cache;
+}
+
+inline void pool_depot::detach(pool_thread_cache* cache) noexcept {
+  std::lock_guard lock(mutex);
+
+  for (std::size_t i = 0; i < CLASSES; i++) {
+    cache->free[i].move_to(free[i], cache->free[i].count);
+  }
+  retired_hits += cache->hits.load();
+  retired_misses += cache->misses.load();
+  (cache->prev ? cache->prev->next : caches) = cache->next;
+  if (cache->next) {
+    cache->next->prev = cache->prev;
+  }
+}
+
+inline pool_depot::counts pool_depot::collect() noexcept {
+  std::lock_guard lock(mutex);
+  counts res{retired_hits, retired_misses, slabs.load(std::memory_order_relaxed)};
+
+  for (pool_thread_cache* cache = caches; cache; cache = cache->next) {
+    res.hits += cache->hits.load();
+    res.misses += cache->misses.load();
+  }
+  return res;
+}
+
+// set once the cache of this thread is destroyed, blocks released later go straight to the depot
+inline thread_local bool pool_cache_destroyed = false;
+
+struct pool_cache_holder {
+  pool_thread_cache cache;
+
+  ~pool_cache_holder() {
+    pool_cache_destroyed = true;
+  }
+};
+
+inline pool_thread_cache* this_thread_cache() noexcept {
+  if (pool_cache_destroyed) {
+    return nullptr;
+  }
+  try {
+    thread_local pool_cache_holder holder;
+    return &holder.cache;
+  } catch (...) {
+    // the cache couldn't be attached, the caller falls back to the depot; the next call retries
+    return nullptr;
+  }
+}
+} // namespace auxiliary
+
+class control_block_pool {
+public:
+  struct statistics {
+    std::size_t hits;   // served from the free list of the calling thread
+    std::size_t misses; // the free list was refilled from the depot
+    std::size_t slabs;  // allocations from the global allocator
+  };
+
+  static bool fits(std::size_t bytes, std::size_t alignment) noexcept {
+    return bytes > 0 && bytes <= auxiliary::pool_depot::MAX_SIZE && alignment <= auxiliary::pool_depot::GRANULARITY;
+  }
+
+  // pre: fits(bytes, alignment)
+  static void* allocate(std::size_t bytes) {
+    using auxiliary::pool_depot;
+
+    std::size_t size_class = pool_depot::class_of(bytes);
+    auxiliary::pool_thread_cache* cache = auxiliary::this_thread_cache();
+
+    if (!cache) {
+      auxiliary::pool_chain one;
+      pool_depot::instance().refill(size_class, one);
+      void* res = one.pop();
+      pool_depot::instance().give_back(size_class, one, one.count);
+      return res;
+    }
+
+    auxiliary::pool_chain& chain = cache->free[size_class];
+
+    if (chain.head) {
+      cache->hits.increment();
+    } else {
+      cache->misses.increment();
+      pool_depot::instance().refill(size_class, chain);
+    }
+    return chain.pop();
+  }
+
+  static void deallocate(void* ptr, std::size_t bytes) noexcept {
+    using auxiliary::pool_depot;
+
+    std::size_t size_class = pool_depot::class_of(bytes);
+    auxiliary::pool_thread_cache* cache = auxiliary::this_thread_cache();
+    auto* node = static_cast<auxiliary::pool_free_node*>(ptr);
+
+    if (!cache) {
+      auxiliary::pool_chain one;
+      one.push(node);
+      pool_depot::instance().give_back(size_class, one, 1);
+      return;
+    }
+
+    auxiliary::pool_chain& chain = cache->free[size_class];
+
+    chain.push(node);
+    if (chain.count > 2 * pool_depot::BATCH) {
+      pool_depot::instance().give_back(size_class, chain, pool_depot::BATCH);
+    }
+  }
+
+  // sums over all threads, exact once the counted threads are idle
+  static statistics stats() noexcept {
+    auto counts = auxiliary::pool_depot::instance().collect();
+    return {counts.hits, counts.misses, counts.slabs};
+  }
+};
+
+// Allocator for shared_ptr(ptr, deleter, alloc) and allocate_shared: single objects of up to
+// 256 bytes come from control_block_pool, anything else from the global allocator.
+template <typename T>
+class pool_allocator {
+public:
+  using value_type = T;
+
+  pool_allocator() = default;
+
+  template <typename U>
+  pool_allocator(const pool_allocator<U>&) noexcept {}
+
+  [[nodiscard]] T* allocate(std::size_t n) {
+    if (n == 1 && control_block_pool::fits(sizeof(T), alignof(T))) {
+      return static_cast<T*>(control_block_pool::allocate(sizeof(T)));
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* ptr, std::size_t n) noexcept {
+    if (n == 1 && control_block_pool::fits(sizeof(T), alignof(T))) {
+      control_block_pool::deallocate(ptr, sizeof(T));
+    } else {
+      std::allocator<T>().deallocate(ptr, n);
+    }
+  }
+
+  friend bool operator==(const pool_allocator&, const pool_allocator&) noexcept {
+    return true;
+  }
+};
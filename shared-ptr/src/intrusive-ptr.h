@@ -0,0 +1,335 @@
+#pragma once
+
+#include "ref-count.h"
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+template <typename T>
+class intrusive_ptr;
+
+template <typename T>
+class weak_intrusive_ptr;
+
+namespace auxiliary {
+// Created on the first weak reference to an object: the object holds one weak reference,
+// strong points to the object's counter while it's alive. The spin lock makes lock() and
+// the last release agree on whether the object still exists.
+template <typename Counter>
+class weak_anchor {
+private:
+  Counter weak_count;
+  std::atomic_flag busy;
+  Counter* strong;
+
+  void acquire() noexcept {
+    while (busy.test_and_set(std::memory_order_acquire)) {}
+  }
+
+  void release() noexcept {
+    busy.clear(std::memory_order_release);
+  }
+
+public:
+  explicit weak_anchor(Counter* strong) noexcept
+      : strong(strong) {}
+
+  weak_anchor(const weak_anchor&) = delete;
+  weak_anchor& operator=(const weak_anchor&) = delete;
+
+  bool strong_increment_if_alive() noexcept {
+    acquire();
+    bool alive = strong && strong->increment_if_nonzero();
+    release();
+    return alive;
+  }
+
+  bool expired() noexcept {
+    acquire();
+    bool res = !strong || strong->load() == 0;
+    release();
+    return res;
+  }
+
+  // called by the object before it's deleted
+  void detach() noexcept {
+    acquire();
+    strong = nullptr;
+    release();
+    weak_decrement();
+  }
+
+  void weak_increment() noexcept {
+    weak_count.increment();
+  }
+
+  void weak_decrement() noexcept {
+    if (weak_count.decrement()) {
+      delete this;
+    }
+  }
+};
+} // namespace auxiliary
+
+// CRTP base that keeps the reference count inside T. The last intrusive_ptr deletes the
+// object as a T, so a T used through pointers to its bases needs a virtual destructor there.
+template <typename T, typename Counter = ref_count_policy::atomic>
+class ref_counted {
+private:
+  mutable Counter count{0};
+  mutable std::atomic<auxiliary::weak_anchor<Counter>*> anchor = nullptr;
+
+  template <typename>
+  friend class intrusive_ptr;
+
+  template <typename>
+  friend class weak_intrusive_ptr;
+
+  void add_ref() const noexcept {
+    count.increment();
+  }
+
+  void release() const noexcept {
+    if (count.decrement()) {
+      if (auto* weak = anchor.load(std::memory_order_acquire)) {
+        weak->detach();
+      }
+      delete static_cast<const T*>(this);
+    }
+  }
+
+  // pre: the caller holds a strong reference
+  auxiliary::weak_anchor<Counter>* weak_anchor() const {
+    auto* weak = anchor.load(std::memory_order_acquire);
+
+    if (!weak) {
+      auto* fresh = new auxiliary::weak_anchor<Counter>(&count);
+
+      if (anchor.compare_exchange_strong(weak, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        weak = fresh;
+      } else {
+        fresh->weak_decrement();
+      }
+    }
+    return weak;
+  }
+
+protected:
+  ref_counted() = default;
+
+  // a copy is a new object with its own count
+  ref_counted(const ref_counted&) noexcept
+      : ref_counted() {}
+
+  ref_counted& operator=(const ref_counted&) noexcept {
+    return *this;
+  }
+
+  ~ref_counted() = default;
+
+public:
+  using ref_count_base = ref_counted;
+  using counter_type = Counter;
+
+  std::size_t use_count() const noexcept {
+    return count.load();
+  }
+};
+
+// One pointer: the count lives in the object, so there's no control block to allocate or
+// to follow. T derives from ref_counted. There's no aliasing constructor, it would need a
+// second word for the owner.
+template <typename T>
+class intrusive_ptr {
+private:
+  T* ptr;
+
+  template <typename>
+  friend class intrusive_ptr;
+
+  template <typename>
+  friend class weak_intrusive_ptr;
+
+  static auto* base(T* ptr) noexcept {
+    return static_cast<const typename std::remove_cv_t<T>::ref_count_base*>(ptr);
+  }
+
+  struct adopt_tag {};
+
+  intrusive_ptr(T* ptr, adopt_tag) noexcept
+      : ptr(ptr) {}
+
+public:
+  intrusive_ptr() noexcept
+      : ptr(nullptr) {}
+
+  intrusive_ptr(std::nullptr_t) noexcept
+      : intrusive_ptr() {}
+
+  // may be called for an object that is already owned, e.g. with this
+  explicit intrusive_ptr(T* ptr) noexcept
+      : ptr(ptr) {
+    if (ptr) {
+      base(ptr)->add_ref();
+    }
+  }
+
+  intrusive_ptr(const intrusive_ptr& other) noexcept
+      : intrusive_ptr(other.ptr) {}
+
+  template <typename Y>
+    requires std::is_convertible_v<Y*, T*>
+  intrusive_ptr(const intrusive_ptr<Y>& other) noexcept
+      : intrusive_ptr(static_cast<T*>(other.ptr)) {}
+
+  intrusive_ptr(intrusive_ptr&& other) noexcept
+      : ptr(std::exchange(other.ptr, nullptr)) {}
+
+  template <typename Y>
+    requires std::is_convertible_v<Y*, T*>
+  intrusive_ptr(intrusive_ptr<Y>&& other) noexcept
+      : ptr(std::exchange(other.ptr, nullptr)) {}
+
+  intrusive_ptr& operator=(const intrusive_ptr& other) noexcept {
+    intrusive_ptr(other).swap(*this);
+    return *this;
+  }
+
+  intrusive_ptr& operator=(intrusive_ptr&& other) noexcept {
+    intrusive_ptr(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  T* get() const noexcept {
+    return ptr;
+  }
+
+  explicit operator bool() const noexcept {
+    return ptr != nullptr;
+  }
+
+  T& operator*() const noexcept {
+    return *ptr;
+  }
+
+  T* operator->() const noexcept {
+    return ptr;
+  }
+
+  std::size_t use_count() const noexcept {
+    return ptr ? base(ptr)->use_count() : 0;
+  }
+
+  void swap(intrusive_ptr& other) noexcept {
+    std::swap(ptr, other.ptr);
+  }
+
+  void reset() noexcept {
+    intrusive_ptr().swap(*this);
+  }
+
+  void reset(T* new_ptr) noexcept {
+    intrusive_ptr(new_ptr).swap(*this);
+  }
+
+  friend bool operator==(const intrusive_ptr& lhs, const intrusive_ptr& rhs) noexcept {
+    return lhs.ptr == rhs.ptr;
+  }
+
+  friend bool operator!=(const intrusive_ptr& lhs, const intrusive_ptr& rhs) noexcept {
+    return lhs.ptr != rhs.ptr;
+  }
+
+  ~intrusive_ptr() {
+    if (ptr) {
+      base(ptr)->release();
+    }
+  }
+};
+
+// The object keeps a pointer to a small anchor, allocated by the first weak reference,
+// that outlives the object while weak references exist.
+template <typename T>
+class weak_intrusive_ptr {
+private:
+  using anchor_type = auxiliary::weak_anchor<typename std::remove_cv_t<T>::counter_type>;
+
+  T* ptr;
+  anchor_type* anchor;
+
+  template <typename>
+  friend class weak_intrusive_ptr;
+
+  weak_intrusive_ptr(T* ptr, anchor_type* anchor) noexcept
+      : ptr(ptr)
+      , anchor(anchor) {
+    if (anchor) {
+      anchor->weak_increment();
+    }
+  }
+
+public:
+  weak_intrusive_ptr() noexcept
+      : ptr(nullptr)
+      , anchor(nullptr) {}
+
+  template <typename Y>
+    requires std::is_convertible_v<Y*, T*>
+  weak_intrusive_ptr(const intrusive_ptr<Y>& other)
+      : weak_intrusive_ptr(other.ptr, other.ptr ? intrusive_ptr<Y>::base(other.ptr)->weak_anchor() : nullptr) {}
+
+  weak_intrusive_ptr(const weak_intrusive_ptr& other) noexcept
+      : weak_intrusive_ptr(other.ptr, other.anchor) {}
+
+  template <typename Y>
+    requires std::is_convertible_v<Y*, T*>
+  weak_intrusive_ptr(const weak_intrusive_ptr<Y>& other) noexcept
+      : weak_intrusive_ptr(other.ptr, other.anchor) {}
+
+  weak_intrusive_ptr(weak_intrusive_ptr&& other) noexcept
+      : ptr(std::exchange(other.ptr, nullptr))
+      , anchor(std::exchange(other.anchor, nullptr)) {}
+
+  weak_intrusive_ptr& operator=(const weak_intrusive_ptr& other) noexcept {
+    weak_intrusive_ptr(other).swap(*this);
+    return *this;
+  }
+
+  weak_intrusive_ptr& operator=(weak_intrusive_ptr&& other) noexcept {
+    weak_intrusive_ptr(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  bool expired() const noexcept {
+    return anchor ? anchor->expired() : true;
+  }
+
+  intrusive_ptr<T> lock() const noexcept {
+    if (anchor && anchor->strong_increment_if_alive()) {
+      return intrusive_ptr<T>(ptr, typename intrusive_ptr<T>::adopt_tag{});
+    }
+    return nullptr;
+  }
+
+  void swap(weak_intrusive_ptr& other) noexcept {
+    std::swap(ptr, other.ptr);
+    std::swap(anchor, other.anchor);
+  }
+
+  void reset() noexcept {
+    weak_intrusive_ptr().swap(*this);
+  }
+
+  ~weak_intrusive_ptr() {
+    if (anchor) {
+      anchor->weak_decrement();
+    }
+  }
+};
+
+template <typename T, typename... Args>
+intrusive_ptr<T> make_intrusive(Args&&... args) {
+  return intrusive_ptr<T>(new T(std::forward<Args>(args)...));
+}
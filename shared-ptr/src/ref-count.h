@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Policies of shared_ptr's strong and weak counters.
+// Counter is created equal to 1 unless told otherwise, decrement() returns true when it drops to 0.
+namespace ref_count_policy {
+// new references are made from existing ones, so increments are relaxed,
+// decrements are acq_rel to order all uses of the object before its destruction
+class atomic {
+private:
+  std::atomic<std::size_t> count = 1;
+
+public:
+  atomic() = default;
+  explicit atomic(std::size_t initial) noexcept
+      : count(initial) {}
+  atomic(const atomic&) = delete;
+  atomic& operator=(const atomic&) = delete;
+
+  std::size_t load() const noexcept {
+    return count.load(std::memory_order_relaxed);
+  }
+
+  void increment(std::size_t n = 1) noexcept {
+    count.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  // for weak_ptr::lock(), the check and the increment are one CAS
+  bool increment_if_nonzero() noexcept {
+    std::size_t current = count.load(std::memory_order_relaxed);
+
+    do {
+      if (current == 0) {
+        return false;
+      }
+    } while (!count.compare_exchange_weak(
+        current,
+        current + 1,
+        std::memory_order_acq_rel,
+        std::memory_order_relaxed
+    ));
+    return true;
+  }
+
+  bool decrement() noexcept {
+    return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+
+  // the caller's reference is the only one; acquire, so former holders are done with the object
+  bool unique() const noexcept {
+    return count.load(std::memory_order_acquire) == 1;
+  }
+};
+
+// plain integer, for pointers that never leave one thread
+class local {
+private:
+  std::size_t count = 1;
+
+public:
+  local() = default;
+  explicit local(std::size_t initial) noexcept
+      : count(initial) {}
+  local(const local&) = delete;
+  local& operator=(const local&) = delete;
+
+  std::size_t load() const noexcept {
+    return count;
+  }
+
+  void increment(std::size_t n = 1) noexcept {
+    count += n;
+  }
+
+  bool increment_if_nonzero() noexcept {
+    if (count == 0) {
+      return false;
+    }
+    ++count;
+    return true;
+  }
+
+  bool decrement() noexcept {
+    return --count == 0;
+  }
+
+  bool unique() const noexcept {
+    return count == 1;
+  }
+};
+} // namespace ref_count_policy
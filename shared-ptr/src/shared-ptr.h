@@ -1,5 +1,7 @@
 #pragma once
 
+#include "ref-count.h"
+
 #include <concepts>
 #include <cstddef>
 #include <memory>
@@ -7,47 +9,102 @@
 #include <utility>
 
 namespace auxiliary {
+enum class release_step {
+  destroy,    // the object
+  deallocate, // the block, with the allocator it was created by
+  both,
+};
+
+// Not polymorphic: the concrete block is released through one function pointer set by the
+// derived constructor, so there's no vtable load and the last release is a single call.
+template <typename Counter>
 struct control_block_base {
 public:
-  std::size_t count;
-  std::size_t weak_count;
+  using release_fn = void (*)(control_block_base*, release_step) noexcept;
+
+  Counter count;
+  // strong owners together hold one weak reference, so exactly one owner frees the block
+  Counter weak_count;
+  release_fn releaser;
 
 protected:
-  virtual void destroy() = 0;
+  explicit control_block_base(release_fn releaser) noexcept
+      : releaser(releaser) {}
+
+  ~control_block_base() = default;
 
 public:
-  control_block_base() noexcept
-      : count(1)
-      , weak_count(0) {}
+
+  std::size_t use_count() const noexcept {
+    return count.load();
+  }
 
   void strong_increment() noexcept {
-    ++count;
+    count.increment();
+  }
+
+  // for weak_ptr::lock(), fails once the object is destroyed
+  bool strong_increment_if_alive() noexcept {
+    return count.increment_if_nonzero();
   }
 
   void weak_increment() noexcept {
-    ++weak_count;
+    weak_count.increment();
   }
 
   void strong_decrement() noexcept {
-    if (--count == 0) {
-      destroy();
-      if (weak_count == 0) {
-        delete this;
+    if (count.decrement()) {
+      // without weak_ptrs nobody else can reach the block, skip the decrement
+      if (weak_count.unique()) {
+        releaser(this, release_step::both);
+      } else {
+        releaser(this, release_step::destroy);
+        weak_decrement();
       }
     }
   }
 
   void weak_decrement() noexcept {
-    if (--weak_count == 0 && count == 0) {
-      delete this;
+    if (weak_count.decrement()) {
+      releaser(this, release_step::deallocate);
     }
   }
-
-  virtual ~control_block_base() = default;
 };
 
-template <typename T, typename Deleter = std::default_delete<T>>
-struct control_block_ref final : public control_block_base {
+// The allocator is rebound to the block type; the block keeps a copy of it to free itself.
+template <typename Block, typename Allocator, typename... Args>
+Block* allocate_control_block(const Allocator& alloc, Args&&... args) {
+  using block_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Block>;
+  using traits = std::allocator_traits<block_allocator>;
+
+  block_allocator block_alloc(alloc);
+  Block* block = traits::allocate(block_alloc, 1);
+
+  try {
+    return std::construct_at(block, alloc, std::forward<Args>(args)...);
+  } catch (...) {
+    traits::deallocate(block_alloc, block, 1);
+    throw;
+  }
+}
+
+template <typename Block>
+void deallocate_control_block(Block* block) noexcept {
+  using block_allocator =
+      typename std::allocator_traits<decltype(block->alloc)>::template rebind_alloc<Block>;
+
+  block_allocator block_alloc(block->alloc);
+
+  std::destroy_at(block);
+  std::allocator_traits<block_allocator>::deallocate(block_alloc, block, 1);
+}
+
+template <
+    typename T,
+    typename Counter,
+    typename Deleter = std::default_delete<T>,
+    typename Allocator = std::allocator<std::remove_cv_t<T>>>
+struct control_block_ref final : public control_block_base<Counter> {
   T* ptr;
 #ifdef _MSC_VER
   [[msvc::no_unique_address]]
@@ -55,64 +112,114 @@ struct control_block_ref final : public control_block_base {
   [[no_unique_address]]
 #endif
   Deleter deleter;
+#ifdef _MSC_VER
+  [[msvc::no_unique_address]]
+#else
+  [[no_unique_address]]
+#endif
+  Allocator alloc;
 
-  control_block_ref() = default;
+  control_block_ref(const Allocator& alloc, T* ptr, Deleter deleter) noexcept
+      : control_block_base<Counter>(&release)
+      , ptr(ptr)
+      , deleter(std::move(deleter))
+      , alloc(alloc) {}
 
-  control_block_ref(T* ptr, Deleter deleter) noexcept
-      : ptr(ptr)
-      , deleter(std::move(deleter)) {}
+  static void release(control_block_base<Counter>* base, release_step step) noexcept {
+    auto* self = static_cast<control_block_ref*>(base);
 
-  void destroy() final {
-    deleter(std::exchange(ptr, nullptr));
+    if (step != release_step::deallocate) {
+      self->deleter(std::exchange(self->ptr, nullptr));
+    }
+    if (step != release_step::destroy) {
+      deallocate_control_block(self);
+    }
   }
-
-  ~control_block_ref() final = default;
 };
 
-template <typename T>
-struct control_block_obj final : public control_block_base {
+// obj is constructed and destroyed through the allocator rebound to T, like std::allocate_shared
+template <typename T, typename Counter, typename Allocator = std::allocator<std::remove_cv_t<T>>>
+struct control_block_obj final : public control_block_base<Counter> {
+  using object_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::remove_cv_t<T>>;
+
+#ifdef _MSC_VER
+  [[msvc::no_unique_address]]
+#else
+  [[no_unique_address]]
+#endif
+  Allocator alloc;
+
   union {
-    T obj;
+    std::remove_cv_t<T> obj;
   };
 
-  control_block_obj() = default;
-
   template <typename... Args>
-  control_block_obj(Args&&... args)
-      : obj(std::forward<Args>(args)...) {}
+  control_block_obj(const Allocator& alloc, Args&&... args)
+      : control_block_base<Counter>(&release)
+      , alloc(alloc) {
+    object_allocator obj_alloc(alloc);
+    std::allocator_traits<object_allocator>::construct(obj_alloc, &obj, std::forward<Args>(args)...);
+  }
+
+  static void release(control_block_base<Counter>* base, release_step step) noexcept {
+    auto* self = static_cast<control_block_obj*>(base);
 
-  void destroy() final {
-    std::destroy_at(&obj);
+    if (step != release_step::deallocate) {
+      object_allocator obj_alloc(self->alloc);
+      std::allocator_traits<object_allocator>::destroy(obj_alloc, &self->obj);
+    }
+    if (step != release_step::destroy) {
+      deallocate_control_block(self);
+    }
   }
 
-  ~control_block_obj() final {}
+  ~control_block_obj() {}
 };
 
 template <class From, class To>
 concept pointer_convertible_to = std::is_convertible_v<From*, To*>;
 } // namespace auxiliary
 
+template <typename T, typename Counter = ref_count_policy::atomic>
+class shared_ptr;
+
 template <typename T>
+class atomic_shared_ptr;
+
+namespace auxiliary {
+template <typename T, typename Counter, typename Allocator, typename... Args>
+shared_ptr<T, Counter> make_shared_with(const Allocator& alloc, Args&&... args);
+} // namespace auxiliary
+
+// Counter is the policy of the reference counters from ref-count.h. Pointers with different
+// policies never share a control block, see the converting constructor.
+template <typename T, typename Counter>
 class shared_ptr {
 private:
+  using control_block_base = auxiliary::control_block_base<Counter>;
+
   T* ptr;
-  auxiliary::control_block_base* control_block;
+  control_block_base* control_block;
 
-  template <typename>
+  template <typename, typename>
   friend class shared_ptr;
 
-  template <typename>
+  template <typename, typename>
   friend class weak_ptr;
 
-  template <typename Y, typename... Args>
-  friend shared_ptr<Y> make_shared(Args&&... args);
+  template <typename>
+  friend class atomic_shared_ptr;
+
+  template <typename Y, typename C, typename Allocator, typename... Args>
+  friend shared_ptr<Y, C> auxiliary::make_shared_with(const Allocator& alloc, Args&&... args);
 
-  shared_ptr(T* ptr, auxiliary::control_block_obj<T>* control_block)
+  template <typename Allocator>
+  shared_ptr(T* ptr, auxiliary::control_block_obj<T, Counter, Allocator>* control_block)
       : ptr(ptr)
       , control_block(control_block) {}
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  shared_ptr(Y* ptr, auxiliary::control_block_base* control_block)
+  shared_ptr(Y* ptr, control_block_base* control_block)
       : ptr(ptr)
       , control_block(control_block) {
     if (control_block) {
@@ -134,9 +241,18 @@ public:
 
   template <auxiliary::pointer_convertible_to<T> Y, typename Deleter>
   shared_ptr(Y* ptr, Deleter deleter)
+      : shared_ptr(ptr, std::move(deleter), std::allocator<std::remove_cv_t<Y>>()) {}
+
+  // the control block is allocated and freed by alloc
+  template <auxiliary::pointer_convertible_to<T> Y, typename Deleter, typename Allocator>
+  shared_ptr(Y* ptr, Deleter deleter, Allocator alloc)
       : ptr(ptr) {
     try {
-      control_block = new auxiliary::control_block_ref(ptr, std::move(deleter));
+      control_block = auxiliary::allocate_control_block<auxiliary::control_block_ref<Y, Counter, Deleter, Allocator>>(
+          alloc,
+          ptr,
+          std::move(deleter)
+      );
     } catch (...) {
       deleter(ptr);
       throw;
@@ -144,11 +260,11 @@ public:
   }
 
   template <typename Y>
-  shared_ptr(const shared_ptr<Y>& other, T* ptr) noexcept
+  shared_ptr(const shared_ptr<Y, Counter>& other, T* ptr) noexcept
       : shared_ptr(ptr, other.control_block) {}
 
   template <typename Y>
-  shared_ptr(shared_ptr<Y>&& other, T* ptr) noexcept
+  shared_ptr(shared_ptr<Y, Counter>&& other, T* ptr) noexcept
       : ptr(ptr)
       , control_block(std::exchange(other.control_block, nullptr)) {
     other.ptr = nullptr;
@@ -158,15 +274,28 @@ public:
       : shared_ptr(other.ptr, other.control_block) {}
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  shared_ptr(const shared_ptr<Y>& other) noexcept
+  shared_ptr(const shared_ptr<Y, Counter>& other) noexcept
       : shared_ptr(other.ptr, other.control_block) {}
 
+  // new control block of this policy which keeps a copy of other until the last owner dies.
+  // Only atomic to local: a local source would be released by whichever thread drops the last
+  // atomic owner
+  template <auxiliary::pointer_convertible_to<T> Y, typename OtherCounter>
+    requires (std::is_same_v<Counter, ref_count_policy::local> &&
+              std::is_same_v<OtherCounter, ref_count_policy::atomic>)
+  explicit shared_ptr(const shared_ptr<Y, OtherCounter>& other)
+      : shared_ptr() {
+    if (other.control_block) {
+      shared_ptr(other.get(), [keep = other](Y*) mutable noexcept { keep.reset(); }).swap(*this);
+    }
+  }
+
   shared_ptr(shared_ptr&& other) noexcept
       : ptr(std::exchange(other.ptr, nullptr))
       , control_block(std::exchange(other.control_block, nullptr)) {}
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  shared_ptr(shared_ptr<Y>&& other) noexcept
+  shared_ptr(shared_ptr<Y, Counter>&& other) noexcept
       : ptr(std::exchange(other.ptr, nullptr))
       , control_block(std::exchange(other.control_block, nullptr)) {}
 
@@ -178,7 +307,7 @@ public:
   }
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  shared_ptr& operator=(const shared_ptr<Y>& other) noexcept {
+  shared_ptr& operator=(const shared_ptr<Y, Counter>& other) noexcept {
     shared_ptr(other).swap(*this);
     return *this;
   }
@@ -191,7 +320,7 @@ public:
   }
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  shared_ptr& operator=(shared_ptr<Y>&& other) noexcept {
+  shared_ptr& operator=(shared_ptr<Y, Counter>&& other) noexcept {
     shared_ptr(std::move(other)).swap(*this);
     return *this;
   }
@@ -213,7 +342,7 @@ public:
   }
 
   std::size_t use_count() const noexcept {
-    return control_block ? control_block->count : 0;
+    return control_block ? control_block->use_count() : 0;
   }
 
   void swap(shared_ptr& other) {
@@ -235,6 +364,11 @@ public:
     shared_ptr(new_ptr, std::move(deleter)).swap(*this);
   }
 
+  template <auxiliary::pointer_convertible_to<T> Y, typename Deleter, typename Allocator>
+  void reset(Y* new_ptr, Deleter deleter, Allocator alloc) {
+    shared_ptr(new_ptr, std::move(deleter), std::move(alloc)).swap(*this);
+  }
+
   friend bool operator==(const shared_ptr& lhs, const shared_ptr& rhs) noexcept {
     return lhs.get() == rhs.get();
   }
@@ -250,17 +384,19 @@ public:
   }
 };
 
-template <typename T>
+template <typename T, typename Counter = ref_count_policy::atomic>
 class weak_ptr {
 private:
+  using control_block_base = auxiliary::control_block_base<Counter>;
+
   T* ptr;
-  auxiliary::control_block_base* control_block;
+  control_block_base* control_block;
 
-  template <typename>
+  template <typename, typename>
   friend class weak_ptr;
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  weak_ptr(Y* ptr, auxiliary::control_block_base* control_block) noexcept
+  weak_ptr(Y* ptr, control_block_base* control_block) noexcept
       : ptr(ptr)
       , control_block(control_block) {
     if (control_block) {
@@ -277,11 +413,11 @@ public:
       : weak_ptr(other.ptr, other.control_block) {}
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  weak_ptr(const shared_ptr<Y>& other) noexcept
+  weak_ptr(const shared_ptr<Y, Counter>& other) noexcept
       : weak_ptr(other.ptr, other.control_block) {}
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  weak_ptr(const weak_ptr<Y>& other) noexcept
+  weak_ptr(const weak_ptr<Y, Counter>& other) noexcept
       : weak_ptr(other.ptr, other.control_block) {}
 
   weak_ptr(weak_ptr&& other) noexcept
@@ -289,7 +425,7 @@ public:
       , control_block(std::exchange(other.control_block, nullptr)) {}
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  weak_ptr(weak_ptr<Y>&& other) noexcept
+  weak_ptr(weak_ptr<Y, Counter>&& other) noexcept
       : ptr(std::exchange(other.ptr, nullptr))
       , control_block(std::exchange(other.control_block, nullptr)) {}
 
@@ -299,7 +435,7 @@ public:
   }
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  weak_ptr& operator=(const shared_ptr<Y>& other) noexcept {
+  weak_ptr& operator=(const shared_ptr<Y, Counter>& other) noexcept {
     weak_ptr(other).swap(*this);
     return *this;
   }
@@ -312,7 +448,7 @@ public:
   }
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  weak_ptr& operator=(const weak_ptr<Y>& other) noexcept {
+  weak_ptr& operator=(const weak_ptr<Y, Counter>& other) noexcept {
     weak_ptr(other).swap(*this);
     return *this;
   }
@@ -325,17 +461,24 @@ public:
   }
 
   template <auxiliary::pointer_convertible_to<T> Y>
-  weak_ptr& operator=(weak_ptr<Y>&& other) noexcept {
+  weak_ptr& operator=(weak_ptr<Y, Counter>&& other) noexcept {
     weak_ptr(std::move(other)).swap(*this);
     return *this;
   }
 
   bool expired() const noexcept {
-    return control_block ? control_block->count == 0 : true;
+    return control_block ? control_block->use_count() == 0 : true;
   }
 
-  shared_ptr<T> lock() const noexcept {
-    return expired() ? shared_ptr<T>() : shared_ptr<T>(ptr, control_block);
+  // the check and the increment are one CAS, so the object can't die in between
+  shared_ptr<T, Counter> lock() const noexcept {
+    shared_ptr<T, Counter> res;
+
+    if (control_block && control_block->strong_increment_if_alive()) {
+      res.ptr = ptr;
+      res.control_block = control_block;
+    }
+    return res;
   }
 
   void reset() noexcept {
@@ -349,9 +492,47 @@ public:
   }
 };
 
+namespace auxiliary {
+template <typename T, typename Counter, typename Allocator, typename... Args>
+shared_ptr<T, Counter> make_shared_with(const Allocator& alloc, Args&&... args) {
+  auto* cb = allocate_control_block<control_block_obj<T, Counter, Allocator>>(alloc, std::forward<Args>(args)...);
+
+  T* obj = &cb->obj;
+
+  return shared_ptr<T, Counter>(obj, cb);
+}
+} // namespace auxiliary
+
 template <typename T, typename... Args>
 shared_ptr<T> make_shared(Args&&... args) {
-  auto* cb = new auxiliary::control_block_obj<T>(std::forward<Args>(args)...);
+  return auxiliary::make_shared_with<T, ref_count_policy::atomic>(
+      std::allocator<std::remove_cv_t<T>>(),
+      std::forward<Args>(args)...
+  );
+}
+
+// object and control block in one allocation from alloc, which also frees it
+template <typename T, typename Allocator, typename... Args>
+shared_ptr<T> allocate_shared(const Allocator& alloc, Args&&... args) {
+  return auxiliary::make_shared_with<T, ref_count_policy::atomic>(alloc, std::forward<Args>(args)...);
+}
+
+// shared_ptr for one thread, copies and releases cost no atomic operations
+template <typename T>
+using local_shared_ptr = shared_ptr<T, ref_count_policy::local>;
+
+template <typename T>
+using local_weak_ptr = weak_ptr<T, ref_count_policy::local>;
+
+template <typename T, typename... Args>
+local_shared_ptr<T> make_local_shared(Args&&... args) {
+  return auxiliary::make_shared_with<T, ref_count_policy::local>(
+      std::allocator<std::remove_cv_t<T>>(),
+      std::forward<Args>(args)...
+  );
+}
 
-  return shared_ptr<T>(&cb->obj, cb);
+template <typename T, typename Allocator, typename... Args>
+local_shared_ptr<T> allocate_local_shared(const Allocator& alloc, Args&&... args) {
+  return auxiliary::make_shared_with<T, ref_count_policy::local>(alloc, std::forward<Args>(args)...);
 }
@@ -0,0 +1,329 @@
+#ifdef __DEFINETELY_UNDEFINED_MACRO
+#define _main main
+#endif
+
+#include "../../common/test.h"
+
+#include "atomic-shared-ptr.h"
+#include "control-block-pool.h"
+#include "intrusive-ptr.h"
+#include "shared-ptr.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+// counts the blocks it holds in *live
+template <typename T>
+struct counting_allocator {
+  using value_type = T;
+
+  int* live;
+
+  explicit counting_allocator(int* live)
+      : live(live) {}
+
+  template <typename U>
+  counting_allocator(const counting_allocator<U>& other) noexcept
+      : live(other.live) {}
+
+  T* allocate(std::size_t n) {
+    ++*live;
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* ptr, std::size_t n) noexcept {
+    --*live;
+    std::allocator<T>().deallocate(ptr, n);
+  }
+
+  template <typename U>
+  friend bool operator==(const counting_allocator& lhs, const counting_allocator<U>& rhs) noexcept {
+    return lhs.live == rhs.live;
+  }
+};
+
+// counts its destructions in *destroyed
+struct tracked {
+  int* destroyed;
+  std::string name;
+
+  tracked(int* destroyed, std::string name)
+      : destroyed(destroyed)
+      , name(std::move(name)) {}
+
+  ~tracked() {
+    ++*destroyed;
+  }
+};
+
+struct thrower {
+  explicit thrower(int) {
+    throw std::runtime_error("thrower");
+  }
+};
+
+struct node : ref_counted<node> {
+  int* destroyed;
+
+  explicit node(int* destroyed)
+      : destroyed(destroyed) {}
+
+  ~node() {
+    ++*destroyed;
+  }
+};
+// both halves are written together, a torn or freed snapshot shows them different
+struct version {
+  inline static std::atomic<int> live = 0;
+
+  int first;
+  int second;
+
+  explicit version(int value)
+      : first(value)
+      , second(value) {
+    live++;
+  }
+
+  ~version() {
+    first = -1;
+    live--;
+  }
+};
+} // namespace
+
+void test_allocate_shared() {
+  int live = 0;
+  int destroyed = 0;
+
+  {
+    auto p = allocate_shared<tracked>(counting_allocator<tracked>(&live), &destroyed, "one");
+    auto q = p;
+
+    // object and block in one allocation
+    _iseq(live, 1);
+    _iseq(p->name, "one");
+    _iseq(q.use_count(), 2u);
+  }
+  _iseq(destroyed, 1);
+  _iseq(live, 0);
+
+  bool thrown = false;
+  try {
+    allocate_shared<thrower>(counting_allocator<thrower>(&live), 1);
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  _check(thrown);
+  _iseq(live, 0);
+}
+
+void test_weak_outlives_strong() {
+  int live = 0;
+  int destroyed = 0;
+
+  auto p = allocate_shared<tracked>(counting_allocator<tracked>(&live), &destroyed, "weak");
+  weak_ptr<tracked> w = p;
+
+  // the object dies with the last strong owner, the block stays for the weak one
+  p.reset();
+  _iseq(destroyed, 1);
+  _iseq(live, 1);
+  _check(w.expired());
+  _check(!w.lock());
+
+  w.reset();
+  _iseq(live, 0);
+}
+
+void test_strong_outlives_weak() {
+  int live = 0;
+  int destroyed = 0;
+
+  auto p = allocate_shared<tracked>(counting_allocator<tracked>(&live), &destroyed, "strong");
+  weak_ptr<tracked> w = p;
+
+  w.reset();
+  _iseq(destroyed, 0);
+  _iseq(live, 1);
+
+  p.reset();
+  _iseq(destroyed, 1);
+  _iseq(live, 0);
+}
+
+void test_local_shared_ptr() {
+  int live = 0;
+  int destroyed = 0;
+
+  {
+    local_shared_ptr<tracked> p = allocate_local_shared<tracked>(counting_allocator<tracked>(&live), &destroyed, "l");
+    local_shared_ptr<tracked> q = p;
+    local_weak_ptr<tracked> w = q;
+
+    _iseq(p.use_count(), 2u);
+    _iseq(w.lock()->name, "l");
+    p.reset();
+    q.reset();
+    _iseq(destroyed, 1);
+    _check(w.expired());
+  }
+  _iseq(live, 0);
+  _iseq(*make_local_shared<int>(42), 42);
+}
+
+void test_cross_policy() {
+  static_assert(std::is_constructible_v<local_shared_ptr<int>, const shared_ptr<int>&>);
+  static_assert(!std::is_convertible_v<shared_ptr<int>, local_shared_ptr<int>>);
+  // the last atomic owner could release a local copy on another thread
+  static_assert(!std::is_constructible_v<shared_ptr<int>, const local_shared_ptr<int>&>);
+
+  int destroyed = 0;
+  auto p = make_shared<tracked>(&destroyed, "shared");
+
+  {
+    local_shared_ptr<tracked> a(p);
+    local_shared_ptr<tracked> b = a;
+
+    // the local block holds one reference to the shared one
+    _iseq(a.get(), p.get());
+    _iseq(p.use_count(), 2u);
+    _iseq(b.use_count(), 2u);
+
+    p.reset();
+    _iseq(destroyed, 0);
+    _iseq(b->name, "shared");
+  }
+  _iseq(destroyed, 1);
+
+  local_shared_ptr<int> empty(shared_ptr<int>{});
+  _check(!empty);
+  _iseq(empty.use_count(), 0u);
+}
+
+void test_weak_intrusive_lock() {
+  int destroyed = 0;
+
+  intrusive_ptr<node> p = make_intrusive<node>(&destroyed);
+  weak_intrusive_ptr<node> w = p;
+  weak_intrusive_ptr<node> w2 = w;
+
+  _iseq(w.lock().get(), p.get());
+  _iseq(p.use_count(), 1u);
+
+  p.reset();
+  _iseq(destroyed, 1);
+  _check(w.expired());
+  _check(!w.lock());
+  _check(!w2.lock());
+}
+
+void test_pool_threads() {
+  constexpr std::size_t THREADS = 4;
+  constexpr std::size_t BLOCKS = 1000;
+
+  control_block_pool::statistics before = control_block_pool::stats();
+  std::vector<std::thread> threads;
+
+  // finished threads hand their counts and free lists back to the depot
+  for (std::size_t i = 0; i < THREADS; i++) {
+    threads.emplace_back([] {
+      for (std::size_t j = 0; j < BLOCKS; j++) {
+        shared_ptr<int> p(new int(0), std::default_delete<int>(), pool_allocator<int>());
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  control_block_pool::statistics after = control_block_pool::stats();
+  _iseq(after.hits + after.misses - before.hits - before.misses, THREADS * BLOCKS);
+}
+
+void test_atomic_shared_ptr() {
+  atomic_shared_ptr<int> a;
+  _check(!a.load());
+
+  a.store(make_shared<int>(1));
+  shared_ptr<int> old = a.exchange(make_shared<int>(2));
+  _iseq(*old, 1);
+  _iseq(*a.load(), 2);
+
+  shared_ptr<int> expected = old;
+  _check(!a.compare_exchange_strong(expected, make_shared<int>(3)));
+  _iseq(*expected, 2);
+  _check(a.compare_exchange_strong(expected, make_shared<int>(3)));
+  _iseq(*a.load(), 3);
+  _iseq(old.use_count(), 1u);
+}
+
+// meant to be run under ASan and TSan
+void test_atomic_shared_ptr_stress() {
+  constexpr int READERS = 4;
+  constexpr int WRITERS = 2;
+  constexpr int VERSIONS = 10000;
+
+  {
+    atomic_shared_ptr<version> a(make_shared<version>(0));
+    std::atomic<int> writers = WRITERS;
+    std::atomic<bool> torn = false;
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < READERS; i++) {
+      threads.emplace_back([&] {
+        while (writers > 0) {
+          shared_ptr<version> snapshot = a.load();
+
+          if (snapshot->first != snapshot->second || snapshot->first < 0) {
+            torn = true;
+          }
+        }
+      });
+    }
+    // one writer stores and exchanges, the other one goes through compare_exchange
+    threads.emplace_back([&] {
+      for (int i = 1; i <= VERSIONS; i++) {
+        if (i % 2 == 0) {
+          a.store(make_shared<version>(i));
+        } else {
+          a.exchange(make_shared<version>(i));
+        }
+      }
+      writers--;
+    });
+    threads.emplace_back([&] {
+      for (int i = 1; i <= VERSIONS; i++) {
+        shared_ptr<version> expected = a.load();
+        while (!a.compare_exchange_weak(expected, make_shared<version>(i))) {}
+      }
+      writers--;
+    });
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    _check(!torn);
+  }
+  _iseq(version::live, 0);
+}
+
+int _main() {
+  _run(test_allocate_shared);
+  _run(test_weak_outlives_strong);
+  _run(test_strong_outlives_weak);
+  _run(test_local_shared_ptr);
+  _run(test_cross_policy);
+  _run(test_weak_intrusive_lock);
+  _run(test_pool_threads);
+  _run(test_atomic_shared_ptr);
+  _run(test_atomic_shared_ptr_stress);
+  return 0;
+}
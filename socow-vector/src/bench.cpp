@@ -0,0 +1,258 @@
+#ifdef __DEFINETELY_UNDEFINED_MACRO
+#define _main main
+#endif
+
+#include "../../common/bench.h"
+
+#include "socow-vector.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Prints one CSV row per (container, element type, SMALL_SIZE, scenario, n):
+// container,type,small_size,scenario,n,ns_per_op
+
+namespace reference {
+// plain small vector without copy-on-write, the baseline for the SSO part
+template <typename T, std::size_t SMALL_SIZE>
+class small_vector {
+private:
+  T* ptr;
+  std::size_t count = 0;
+  std::size_t cap = SMALL_SIZE;
+
+  union {
+    T sbuf[SMALL_SIZE];
+  };
+
+  bool is_small() const noexcept {
+    return ptr == sbuf;
+  }
+
+  void adopt(small_vector&& other) noexcept {
+    if (other.is_small()) {
+      ptr = sbuf;
+      cap = SMALL_SIZE;
+      std::uninitialized_move_n(other.sbuf, other.count, sbuf);
+      std::destroy_n(other.sbuf, other.count);
+    } else {
+      ptr = std::exchange(other.ptr, other.sbuf);
+      cap = std::exchange(other.cap, SMALL_SIZE);
+    }
+    count = std::exchange(other.count, 0);
+  }
+
+  void reallocate(std::size_t new_cap) {
+    T* new_ptr = new_cap <= SMALL_SIZE ? sbuf : static_cast<T*>(::operator new(new_cap * sizeof(T)));
+
+    std::uninitialized_move_n(ptr, count, new_ptr);
+    std::destroy_n(ptr, count);
+    release();
+    ptr = new_ptr;
+    cap = std::max(new_cap, SMALL_SIZE);
+  }
+
+  void release() noexcept {
+    if (!is_small()) {
+      ::operator delete(ptr);
+    }
+  }
+
+public:
+  small_vector()
+    : ptr(sbuf) {}
+
+  small_vector(const small_vector& other)
+    : small_vector() {
+    reserve(other.count);
+    std::uninitialized_copy_n(other.ptr, other.count, ptr);
+    count = other.count;
+  }
+
+  small_vector(small_vector&& other) noexcept {
+    adopt(std::move(other));
+  }
+
+  small_vector& operator=(small_vector&& other) noexcept {
+    if (this != &other) {
+      clear();
+      release();
+      adopt(std::move(other));
+    }
+    return *this;
+  }
+
+  ~small_vector() {
+    clear();
+    release();
+  }
+
+  std::size_t size() const noexcept {
+    return count;
+  }
+
+  T& operator[](std::size_t index) noexcept {
+    return ptr[index];
+  }
+
+  T* begin() noexcept {
+    return ptr;
+  }
+
+  T* end() noexcept {
+    return ptr + count;
+  }
+
+  void reserve(std::size_t new_cap) {
+    if (new_cap > cap) {
+      reallocate(new_cap);
+    }
+  }
+
+  void push_back(const T& elem) {
+    if (count == cap) {
+      T copy(elem);
+
+      reallocate(cap * 2);
+      std::construct_at(ptr + count, std::move(copy));
+    } else {
+      std::construct_at(ptr + count, elem);
+    }
+    count++;
+  }
+
+  void pop_back() noexcept {
+    std::destroy_at(ptr + --count);
+  }
+
+  T* insert(const T* pos, const T& elem) {
+    std::size_t ind = pos - ptr;
+
+    push_back(elem);
+    std::rotate(ptr + ind, ptr + count - 1, ptr + count);
+    return ptr + ind;
+  }
+
+  T* erase(const T* pos) {
+    std::size_t ind = pos - ptr;
+
+    std::move(ptr + ind + 1, ptr + count, ptr + ind);
+    pop_back();
+    return ptr + ind;
+  }
+
+  void shrink_to_fit() {
+    if (!is_small() && count < cap) {
+      reallocate(count);
+    }
+  }
+
+  void clear() noexcept {
+    std::destroy_n(ptr, count);
+    count = 0;
+  }
+
+  void swap(small_vector& other) noexcept {
+    small_vector tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+  }
+};
+} // namespace reference
+
+namespace bench {
+template <typename T>
+T make(std::size_t i) {
+  if constexpr (std::is_same_v<T, std::string>) {
+    return "string that does not fit in sso #" + std::to_string(i);
+  } else {
+    return static_cast<T>(i);
+  }
+}
+
+template <typename Vector, typename T>
+Vector filled(std::size_t n) {
+  Vector v;
+
+  for (std::size_t i = 0; i < n; i++) {
+    v.push_back(make<T>(i));
+  }
+  return v;
+}
+
+template <typename Vector, typename T>
+void run_scenarios(std::string_view container, std::string_view type, std::size_t small_size) {
+  T elem = make<T>(42);
+
+  for (std::size_t n : {small_size / 2, small_size, std::size_t(64), std::size_t(4096)}) {
+    report(container, type, small_size, "push_back", n, measure([&] {
+      Vector v = filled<Vector, T>(n);
+      keep(v);
+    }));
+
+    Vector base = filled<Vector, T>(n);
+
+    report(container, type, small_size, "insert_erase_middle", n, measure([&] {
+      base.insert(base.begin() + n / 2, elem);
+      base.erase(base.begin() + n / 2);
+      keep(base);
+    }));
+
+    report(container, type, small_size, "copy", n, measure([&] {
+      Vector copy(base);
+      keep(copy);
+    }));
+
+    if (n > 0) {
+      report(container, type, small_size, "copy_mutate", n, measure([&] {
+        Vector copy(base);
+        copy[n / 2] = elem;
+        keep(copy);
+      }));
+    }
+
+    report(container, type, small_size, "shrink_to_fit", n, measure([&] {
+      Vector v = filled<Vector, T>(n);
+      v.reserve(2 * n + 1);
+      v.shrink_to_fit();
+      keep(v);
+    }));
+  }
+
+  Vector small_one = filled<Vector, T>(small_size / 2);
+  Vector big_one = filled<Vector, T>(64);
+
+  report(container, type, small_size, "swap_static_dynamic", small_size / 2, measure([&] {
+    small_one.swap(big_one);
+    keep(small_one);
+  }));
+}
+
+template <typename T, std::size_t SMALL_SIZE>
+void run_all(std::string_view type) {
+  run_scenarios<std::vector<T>, T>("std_vector", type, SMALL_SIZE);
+  run_scenarios<reference::small_vector<T, SMALL_SIZE>, T>("small_vector", type, SMALL_SIZE);
+  run_scenarios<socow_vector<T, SMALL_SIZE>, T>("socow_vector", type, SMALL_SIZE);
+}
+
+template <typename T>
+void run_sizes(std::string_view type) {
+  run_all<T, 1>(type);
+  run_all<T, 4>(type);
+  run_all<T, 16>(type);
+}
+} // namespace bench
+
+int _main() {
+  std::cout << "container,type,small_size,scenario,n,ns_per_op\n";
+  bench::run_sizes<int>("int");
+  bench::run_sizes<double>("double");
+  bench::run_sizes<std::string>("string");
+  return 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+// Policies of socow_vector's capacity growth.
+// grow(capacity, required, element_size, header_size) returns new capacity not less than required.
+namespace growth_policy {
+struct doubling {
+  static std::size_t grow(std::size_t capacity, std::size_t required, std::size_t, std::size_t) noexcept {
+    return std::max(2 * capacity, required);
+  }
+};
+
+struct one_and_half {
+  static std::size_t grow(std::size_t capacity, std::size_t required, std::size_t, std::size_t) noexcept {
+    return std::max(capacity + capacity / 2, required);
+  }
+};
+
+// rounds up result of Base so that big buffers (header + data) occupy whole pages
+template <typename Base = doubling, std::size_t PAGE_SIZE = 4096>
+  requires (PAGE_SIZE > 0)
+struct page_aligned {
+  static std::size_t
+  grow(std::size_t capacity, std::size_t required, std::size_t element_size, std::size_t header_size) noexcept {
+    std::size_t new_capacity = Base::grow(capacity, required, element_size, header_size);
+    std::size_t bytes = header_size + new_capacity * element_size;
+
+    if (bytes < PAGE_SIZE) {
+      return new_capacity;
+    }
+    bytes = (bytes + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    return (bytes - header_size) / element_size;
+  }
+};
+} // namespace growth_policy
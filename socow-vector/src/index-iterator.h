@@ -0,0 +1,108 @@
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+namespace auxiliary {
+// Random access over a container that is read through its const operator[]. With proxy rows
+// (a tuple of references) it's only an input iterator for the legacy algorithms, which expect
+// a real reference; the random access concept also needs tuple's common_reference from C++23.
+template <typename Owner, typename Value, typename Reference>
+class index_iterator {
+public:
+  using value_type = Value;
+  using difference_type = std::ptrdiff_t;
+  using reference = Reference;
+  using iterator_category = std::conditional_t<
+      std::is_reference_v<Reference>,
+      std::random_access_iterator_tag,
+      std::input_iterator_tag>;
+  using iterator_concept = std::random_access_iterator_tag;
+
+private:
+  const Owner* owner = nullptr;
+  std::size_t index = 0;
+
+  friend Owner;
+
+  index_iterator(const Owner* owner, std::size_t index) noexcept
+      : owner(owner)
+      , index(index) {}
+
+public:
+  index_iterator() = default;
+
+  reference operator*() const {
+    return (*owner)[index];
+  }
+
+  auto operator->() const
+    requires std::is_reference_v<Reference>
+  {
+    return std::addressof((*owner)[index]);
+  }
+
+  reference operator[](difference_type n) const {
+    return (*owner)[index + n];
+  }
+
+  index_iterator& operator++() {
+    index++;
+    return *this;
+  }
+
+  index_iterator operator++(int) {
+    index_iterator prev = *this;
+    ++*this;
+    return prev;
+  }
+
+  index_iterator& operator--() {
+    index--;
+    return *this;
+  }
+
+  index_iterator operator--(int) {
+    index_iterator prev = *this;
+    --*this;
+    return prev;
+  }
+
+  index_iterator& operator+=(difference_type n) {
+    index += n;
+    return *this;
+  }
+
+  index_iterator& operator-=(difference_type n) {
+    index -= n;
+    return *this;
+  }
+
+  friend index_iterator operator+(index_iterator it, difference_type n) {
+    return it += n;
+  }
+
+  friend index_iterator operator+(difference_type n, index_iterator it) {
+    return it += n;
+  }
+
+  friend index_iterator operator-(index_iterator it, difference_type n) {
+    return it -= n;
+  }
+
+  friend difference_type operator-(const index_iterator& lhs, const index_iterator& rhs) {
+    return static_cast<difference_type>(lhs.index) - static_cast<difference_type>(rhs.index);
+  }
+
+  friend bool operator==(const index_iterator& lhs, const index_iterator& rhs) {
+    return lhs.index == rhs.index;
+  }
+
+  friend auto operator<=>(const index_iterator& lhs, const index_iterator& rhs) {
+    return lhs.index <=> rhs.index;
+  }
+};
+} // namespace auxiliary
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Copies of trivially copyable buffers of at least threshold bytes are split between
+// threads workers (the calling one included) and written with non-temporal stores.
+struct socow_large_copy_config {
+  std::size_t threshold = std::size_t(8) << 20;
+  std::size_t threads = 4;
+};
+
+namespace auxiliary {
+// runs parts of one job at a time, the calling thread takes part too
+class copy_pool {
+private:
+  std::mutex mutex;
+  std::condition_variable has_work;
+  std::condition_variable done;
+  std::mutex run_mutex;
+  std::vector<std::thread> workers;
+
+  const std::function<void(std::size_t)>* task = nullptr;
+  std::size_t parts = 0;
+  std::size_t next = 0;
+  std::size_t finished = 0;
+  bool stop = false;
+
+  void work() {
+    for (;;) {
+      std::size_t part;
+      {
+        std::lock_guard lock(mutex);
+        if (next >= parts) {
+          return;
+        }
+        part = next++;
+      }
+      (*task)(part);
+      {
+        std::lock_guard lock(mutex);
+        if (++finished == parts) {
+          done.notify_all();
+        }
+      }
+    }
+  }
+
+  void loop() {
+    std::unique_lock lock(mutex);
+
+    for (;;) {
+      has_work.wait(lock, [this] { return stop || next < parts; });
+      if (stop) {
+        return;
+      }
+      lock.unlock();
+      work();
+      lock.lock();
+    }
+  }
+
+  void shutdown() noexcept {
+    {
+      std::lock_guard lock(mutex);
+      stop = true;
+    }
+    has_work.notify_all();
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+  }
+
+public:
+  explicit copy_pool(std::size_t threads) {
+    try {
+      for (std::size_t i = 1; i < threads; i++) {
+        workers.emplace_back([this] { loop(); });
+      }
+    } catch (...) {
+      // joinable threads mustn't be destroyed
+      shutdown();
+      throw;
+    }
+  }
+
+  copy_pool(const copy_pool&) = delete;
+  copy_pool& operator=(const copy_pool&) = delete;
+
+  std::size_t size() const noexcept {
+    return workers.size() + 1;
+  }
+
+  void run(std::size_t count, const std::function<void(std::size_t)>& fn) {
+    std::lock_guard run_lock(run_mutex);
+    {
+      std::lock_guard lock(mutex);
+      task = &fn;
+      parts = count;
+      next = 0;
+      finished = 0;
+    }
+    has_work.notify_all();
+    work();
+
+    std::unique_lock lock(mutex);
+    done.wait(lock, [this] { return finished == parts; });
+    task = nullptr;
+  }
+
+  ~copy_pool() {
+    shutdown();
+  }
+};
+
+class large_copy {
+private:
+  inline static std::mutex config_mutex;
+  inline static socow_large_copy_config config;
+  inline static std::shared_ptr<copy_pool> pool;
+  // copies below it skip the mutex, so small unshares stay lock-free
+  inline static std::atomic<std::size_t> parallel_threshold = socow_large_copy_config().threshold;
+
+  static std::size_t threshold_of(const socow_large_copy_config& config) noexcept {
+    return config.threads <= 1 ? SIZE_MAX : config.threshold;
+  }
+
+  static std::shared_ptr<copy_pool> current_pool(std::size_t bytes) {
+    std::lock_guard lock(config_mutex);
+
+    if (bytes < config.threshold || config.threads <= 1) {
+      return nullptr;
+    }
+    if (pool == nullptr) {
+      pool = std::make_shared<copy_pool>(config.threads);
+    }
+    return pool;
+  }
+
+  // bypasses the cache, so a huge copy doesn't evict the working set
+  static void stream_copy(std::byte* to, const std::byte* from, std::size_t bytes) noexcept {
+#ifdef __SSE2__
+    std::size_t head = std::min(bytes, (16 - reinterpret_cast<std::uintptr_t>(to) % 16) % 16);
+
+    std::memcpy(to, from, head);
+    to += head;
+    from += head;
+    bytes -= head;
+    for (; bytes >= 64; bytes -= 64, to += 64, from += 64) {
+      for (std::size_t i = 0; i < 64; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+
+        _mm_stream_si128(reinterpret_cast<__m128i*>(to + i), chunk);
+      }
+    }
+    _mm_sfence();
+#endif
+    std::memcpy(to, from, bytes);
+  }
+
+public:
+  static void copy(void* to, const void* from, std::size_t bytes) {
+    std::shared_ptr<copy_pool> workers =
+        bytes < parallel_threshold.load(std::memory_order_relaxed) ? nullptr : current_pool(bytes);
+
+    if (workers == nullptr) {
+      std::memcpy(to, from, bytes);
+      return;
+    }
+
+    std::size_t parts = workers->size();
+    std::size_t part_size = (bytes / parts + 63) / 64 * 64;
+
+    workers->run(parts, [&](std::size_t part) {
+      std::size_t first = std::min(bytes, part * part_size);
+      std::size_t last = std::min(bytes, first + part_size);
+
+      stream_copy(static_cast<std::byte*>(to) + first, static_cast<const std::byte*>(from) + first, last - first);
+    });
+  }
+
+  static socow_large_copy_config get_config() {
+    std::lock_guard lock(config_mutex);
+    return config;
+  }
+
+  // running copies finish on the old pool
+  static void set_config(const socow_large_copy_config& new_config) {
+    std::lock_guard lock(config_mutex);
+    config = new_config;
+    parallel_threshold.store(threshold_of(new_config), std::memory_order_relaxed);
+    pool = nullptr;
+  }
+};
+} // namespace auxiliary
+
+inline socow_large_copy_config get_socow_large_copy_config() {
+  return auxiliary::large_copy::get_config();
+}
+
+inline void set_socow_large_copy_config(const socow_large_copy_config& config) {
+  auxiliary::large_copy::set_config(config);
+}
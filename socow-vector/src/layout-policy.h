@@ -0,0 +1,185 @@
+#pragma once
+
+#include "size-state.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+namespace auxiliary {
+struct no_buffer_size {};
+} // namespace auxiliary
+
+// Where socow_vector keeps its size and static/dynamic state. A storage holds either
+// SMALL_SIZE inline elements or a pointer to a heap Buffer; all sharers of a buffer have
+// the same size, since a size change of a shared vector always unshares it first.
+namespace layout_policy {
+// size word with the state bit next to the inline elements, heap header has no size
+struct split {
+  using buffer_size = auxiliary::no_buffer_size;
+
+  // bound on SMALL_SIZE of an object of at most bytes bytes
+  template <typename T>
+  static constexpr std::size_t max_small_size(std::size_t bytes) noexcept {
+    return bytes > sizeof(auxiliary::size_state) ? (bytes - sizeof(auxiliary::size_state)) / sizeof(T) : 0;
+  }
+
+  template <typename T, std::size_t SMALL_SIZE, typename Buffer>
+  class storage {
+  private:
+    auxiliary::size_state info;
+
+    union {
+      T sbuf_[SMALL_SIZE];
+      Buffer* dbuf_;
+    };
+
+  public:
+    storage() {}
+
+    storage(const storage&) = delete;
+    storage& operator=(const storage&) = delete;
+
+    ~storage() {}
+
+    std::size_t size() const noexcept {
+      return info.size();
+    }
+
+    bool is_static() const noexcept {
+      return info.is_static();
+    }
+
+    bool is_dynamic() const noexcept {
+      return info.is_dynamic();
+    }
+
+    T* sbuf() noexcept {
+      return sbuf_;
+    }
+
+    const T* sbuf() const noexcept {
+      return sbuf_;
+    }
+
+    Buffer* dbuf() const noexcept {
+      return dbuf_;
+    }
+
+    void set_size(std::size_t new_size) noexcept {
+      info.set_size(new_size);
+    }
+
+    // pre: the elements are already in sbuf()
+    void set_static(std::size_t new_size) noexcept {
+      info.make_static();
+      info.set_size(new_size);
+    }
+
+    // pre: the elements are already in buf
+    void set_dynamic(Buffer* buf, std::size_t new_size) noexcept {
+      dbuf_ = buf;
+      info.make_dyamic();
+      info.set_size(new_size);
+    }
+
+    void reset() noexcept {
+      info.reset();
+    }
+  };
+};
+
+// One word for empty and dynamic vectors: either a pointer to the heap buffer, which keeps
+// the size, or a tag byte (size << 1 | 1) in place of the pointer's lowest byte followed by
+// the inline elements. Buffers are aligned, so the lowest bit of a pointer is always 0.
+struct compact {
+  using buffer_size = std::size_t;
+
+  template <typename T>
+  static constexpr std::size_t max_small_size(std::size_t bytes) noexcept {
+    return std::min<std::size_t>(bytes > alignof(T) ? (bytes - alignof(T)) / sizeof(T) : 0, 127);
+  }
+
+  template <typename T, std::size_t SMALL_SIZE, typename Buffer>
+  class storage {
+  private:
+    static_assert(std::endian::native == std::endian::little, "compact layout needs a little-endian target");
+    static_assert(SMALL_SIZE < 128, "compact layout keeps the static size in 7 bits");
+
+    static constexpr std::size_t OFFSET = alignof(T);
+    static constexpr std::size_t BYTES = std::max(sizeof(Buffer*), OFFSET + SMALL_SIZE * sizeof(T));
+
+    alignas(std::max(alignof(T), alignof(Buffer*))) unsigned char bytes[BYTES];
+
+    unsigned char tag() const noexcept {
+      return bytes[0];
+    }
+
+  public:
+    storage() {
+      set_static(0);
+    }
+
+    storage(const storage&) = delete;
+    storage& operator=(const storage&) = delete;
+
+    ~storage() = default;
+
+    std::size_t size() const noexcept {
+      return is_static() ? tag() >> 1 : dbuf()->size;
+    }
+
+    bool is_static() const noexcept {
+      return tag() & 1;
+    }
+
+    bool is_dynamic() const noexcept {
+      return !is_static();
+    }
+
+    T* sbuf() noexcept {
+      return std::launder(reinterpret_cast<T*>(bytes + OFFSET));
+    }
+
+    const T* sbuf() const noexcept {
+      return std::launder(reinterpret_cast<const T*>(bytes + OFFSET));
+    }
+
+    Buffer* dbuf() const noexcept {
+      Buffer* buf;
+
+      std::memcpy(&buf, bytes, sizeof(buf));
+      return buf;
+    }
+
+    // pre: the buffer, if any, is not shared
+    void set_size(std::size_t new_size) noexcept {
+      if (is_static()) {
+        set_static(new_size);
+      } else {
+        dbuf()->size = new_size;
+      }
+    }
+
+    // pre: the elements are already in sbuf()
+    void set_static(std::size_t new_size) noexcept {
+      bytes[0] = static_cast<unsigned char>(new_size << 1 | 1);
+    }
+
+    // pre: the elements are already in buf
+    void set_dynamic(Buffer* buf, std::size_t new_size) noexcept {
+      // the header of a shared buffer already holds new_size and mustn't be written concurrently
+      if (buf->size != new_size) {
+        buf->size = new_size;
+      }
+      std::memcpy(bytes, &buf, sizeof(buf));
+    }
+
+    void reset() noexcept {
+      set_static(0);
+    }
+  };
+};
+} // namespace layout_policy
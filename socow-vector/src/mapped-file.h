@@ -0,0 +1,235 @@
+#pragma once
+
+// Files with socow_vector data and buffers mapped from them, POSIX only.
+#if __has_include(<sys/mman.h>)
+#define SOCOW_VECTOR_HAS_MMAP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <utility>
+
+enum class socow_map_mode {
+  read_only,     // pages are shared with other processes, any change copies the data to the heap
+  copy_on_write, // the OS copies a page on the first write to it
+};
+
+namespace auxiliary {
+struct mapped_file_header {
+  static constexpr char MAGIC[8] = {'s', 'o', 'c', 'o', 'w', 'v', 'e', 'c'};
+  static constexpr std::uint32_t VERSION = 1;
+  // covers every common page size, the gap is a hole in the file
+  static constexpr std::uint64_t DATA_OFFSET = 1 << 16;
+
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t element_size;
+  std::uint64_t count;
+  std::uint64_t data_offset; // multiple of the page size, so the data is mapped directly
+};
+
+// lives at the start of the mapped region, before the buffer header
+struct file_mapping {
+  void* base;
+  std::size_t length;
+  bool read_only;
+};
+
+struct mapped_data {
+  const file_mapping* mapping;
+  std::byte* data;
+  std::size_t count;
+};
+
+[[noreturn]] inline void throw_errno(const char* what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+inline std::size_t page_size() noexcept {
+  return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+inline std::size_t round_up(std::size_t value, std::size_t multiple) noexcept {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+class file_descriptor {
+private:
+  int fd;
+
+public:
+  file_descriptor(const char* path, int flags, mode_t mode = 0)
+    : fd(::open(path, flags | O_CLOEXEC, mode)) {
+    if (fd < 0) {
+      throw_errno("socow_vector: can't open file");
+    }
+  }
+
+  file_descriptor(const file_descriptor&) = delete;
+  file_descriptor& operator=(const file_descriptor&) = delete;
+
+  int get() const noexcept {
+    return fd;
+  }
+
+  void write_all(const void* data, std::size_t bytes, std::size_t offset) const {
+    auto* from = static_cast<const std::byte*>(data);
+
+    while (bytes > 0) {
+      ssize_t written = ::pwrite(fd, from, bytes, static_cast<off_t>(offset));
+
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw_errno("socow_vector: can't write file");
+      }
+      from += written;
+      offset += written;
+      bytes -= written;
+    }
+  }
+
+  void read_all(void* data, std::size_t bytes, std::size_t offset) const {
+    auto* to = static_cast<std::byte*>(data);
+
+    while (bytes > 0) {
+      ssize_t got = ::pread(fd, to, bytes, static_cast<off_t>(offset));
+
+      if (got < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw_errno("socow_vector: can't read file");
+      }
+      if (got == 0) {
+        throw std::system_error(std::make_error_code(std::errc::invalid_argument), "socow_vector: file is truncated");
+      }
+      to += got;
+      offset += got;
+      bytes -= got;
+    }
+  }
+
+  ~file_descriptor() {
+    ::close(fd);
+  }
+};
+
+inline void write_mapped_file(const char* path, const void* data, std::size_t element_size, std::size_t count) {
+  file_descriptor file(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  mapped_file_header header{};
+
+  std::memcpy(header.magic, mapped_file_header::MAGIC, sizeof(header.magic));
+  header.version = mapped_file_header::VERSION;
+  header.element_size = static_cast<std::uint32_t>(element_size);
+  header.count = count;
+  header.data_offset = mapped_file_header::DATA_OFFSET;
+
+  file.write_all(&header, sizeof(header), 0);
+  file.write_all(data, count * element_size, header.data_offset);
+  if (::ftruncate(file.get(), static_cast<off_t>(header.data_offset + count * element_size)) != 0) {
+    throw_errno("socow_vector: can't write file");
+  }
+}
+
+// Maps the data of a file right after at least prefix_bytes of private anonymous memory,
+// so the data is page aligned. The mapping is freed by unmap().
+inline mapped_data map_file(const char* path, std::size_t element_size, std::size_t prefix_bytes, socow_map_mode mode) {
+  file_descriptor file(path, O_RDONLY);
+  mapped_file_header header;
+  struct stat info;
+
+  file.read_all(&header, sizeof(header), 0);
+  if (::fstat(file.get(), &info) != 0) {
+    throw_errno("socow_vector: can't stat file");
+  }
+  if (std::memcmp(header.magic, mapped_file_header::MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != mapped_file_header::VERSION || header.element_size != element_size ||
+      header.data_offset % page_size() != 0 || static_cast<std::uint64_t>(info.st_size) < header.data_offset ||
+      header.count > (static_cast<std::uint64_t>(info.st_size) - header.data_offset) / element_size) {
+    throw std::system_error(std::make_error_code(std::errc::invalid_argument), "socow_vector: bad mapped file");
+  }
+
+  std::size_t data_bytes = header.count * element_size;
+  std::size_t prefix = round_up(sizeof(file_mapping) + prefix_bytes, page_size());
+  std::size_t length = prefix + round_up(data_bytes, page_size());
+  void* base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (base == MAP_FAILED) {
+    throw_errno("socow_vector: can't map file");
+  }
+
+  auto* data = static_cast<std::byte*>(base) + prefix;
+  bool read_only = mode == socow_map_mode::read_only;
+
+  if (data_bytes > 0) {
+    int protection = read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = (read_only ? MAP_SHARED : MAP_PRIVATE) | MAP_FIXED;
+
+    if (::mmap(data, data_bytes, protection, flags, file.get(), static_cast<off_t>(header.data_offset)) == MAP_FAILED) {
+      int error = errno;
+
+      ::munmap(base, length);
+      throw std::system_error(error, std::generic_category(), "socow_vector: can't map file");
+    }
+  }
+  return {std::construct_at(static_cast<file_mapping*>(base), base, length, read_only), data, data_bytes / element_size};
+}
+
+inline void unmap(const file_mapping* mapping) noexcept {
+  ::munmap(mapping->base, mapping->length);
+}
+} // namespace auxiliary
+
+// Allocator of mapped socow_vectors: new buffers come from the heap, a buffer
+// created by map_from_file keeps a copy that unmaps the file instead.
+template <typename T>
+class mapped_allocator {
+private:
+  const auxiliary::file_mapping* mapping = nullptr;
+
+  template <typename U>
+  friend class mapped_allocator;
+
+public:
+  using value_type = T;
+
+  mapped_allocator() = default;
+
+  explicit mapped_allocator(const auxiliary::file_mapping* mapping) noexcept
+    : mapping(mapping) {}
+
+  template <typename U>
+  mapped_allocator(const mapped_allocator<U>& other) noexcept
+    : mapping(other.mapping) {}
+
+  [[nodiscard]] T* allocate(std::size_t n) {
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* ptr, std::size_t n) noexcept {
+    if (mapping != nullptr) {
+      auxiliary::unmap(mapping);
+    } else {
+      std::allocator<T>().deallocate(ptr, n);
+    }
+  }
+
+  // mapped pages that mustn't be written
+  bool read_only() const noexcept {
+    return mapping != nullptr && mapping->read_only;
+  }
+
+  friend bool operator==(const mapped_allocator& lhs, const mapped_allocator& rhs) = default;
+};
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+
+// T has reflexive equality if x == x holds for every value. Floating-point numbers and types
+// that hold them don't (NaN), so only integral, enum and pointer types are assumed to,
+// user types opt in by specializing.
+template <typename T>
+struct has_reflexive_equality
+    : std::bool_constant<
+          std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T> || std::is_member_pointer_v<T> ||
+          std::is_null_pointer_v<T>> {};
+
+template <typename Char, typename Traits, typename Allocator>
+struct has_reflexive_equality<std::basic_string<Char, Traits, Allocator>> : has_reflexive_equality<Char> {};
+
+template <typename T>
+inline constexpr bool has_reflexive_equality_v = has_reflexive_equality<T>::value;
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "index-iterator.h"
+#include "socow-vector.h"
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace auxiliary {
+template <typename T, std::size_t CHUNK_SIZE, typename ShareCount>
+struct cow_chunk {
+  ShareCount share_count;
+  std::size_t size = 0;
+
+  union {
+    T data[CHUNK_SIZE];
+  };
+
+  cow_chunk() {}
+
+  cow_chunk(const cow_chunk&) = delete;
+  cow_chunk& operator=(const cow_chunk&) = delete;
+
+  ~cow_chunk() {
+    std::destroy_n(data, size);
+  }
+};
+
+// owning handle of a shared chunk, copying it only bumps the share count
+template <typename T, std::size_t CHUNK_SIZE, typename ShareCount>
+class chunk_ref {
+private:
+  using chunk = cow_chunk<T, CHUNK_SIZE, ShareCount>;
+
+  chunk* ptr;
+
+public:
+  chunk_ref()
+    : ptr(new chunk) {}
+
+  chunk_ref(const chunk_ref& other) noexcept
+    : ptr(other.ptr) {
+    ptr->share_count.increment();
+  }
+
+  chunk_ref(chunk_ref&& other) noexcept
+    : ptr(std::exchange(other.ptr, nullptr)) {}
+
+  chunk_ref& operator=(const chunk_ref& other) noexcept {
+    chunk_ref(other).swap(*this);
+    return *this;
+  }
+
+  chunk_ref& operator=(chunk_ref&& other) noexcept {
+    chunk_ref(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  void swap(chunk_ref& other) noexcept {
+    std::swap(ptr, other.ptr);
+  }
+
+  const chunk& get() const noexcept {
+    return *ptr;
+  }
+
+  chunk& unshared() /* strong */ {
+    if (!ptr->share_count.unique()) {
+      std::unique_ptr<chunk> copy(new chunk);
+
+      std::uninitialized_copy_n(ptr->data, ptr->size, copy->data);
+      copy->size = ptr->size;
+      unshare_counter::record(ptr->size);
+      chunk_ref old(std::exchange(ptr, copy.release()));
+    }
+    return *ptr;
+  }
+
+  ~chunk_ref() {
+    if (ptr != nullptr && ptr->share_count.decrement()) {
+      delete ptr;
+    }
+  }
+
+private:
+  // adopts an existing reference
+  explicit chunk_ref(chunk* ptr) noexcept
+    : ptr(ptr) {}
+};
+} // namespace auxiliary
+
+// Vector with copy-on-write of fixed-size chunks: a write to a shared vector copies
+// the chunk directory and the touched chunk only. Up to SMALL_SIZE elements are
+// stored in a plain socow_vector.
+template <
+    typename T,
+    std::size_t SMALL_SIZE,
+    std::size_t CHUNK_SIZE = 512,
+    typename ShareCount = share_count_policy::single_threaded>
+  requires (SMALL_SIZE > 0 && CHUNK_SIZE >= SMALL_SIZE)
+class segmented_socow_vector {
+public:
+  using value_type = T;
+  using reference = T&;
+  using const_reference = const T&;
+
+private:
+  using chunk_ref = auxiliary::chunk_ref<T, CHUNK_SIZE, ShareCount>;
+
+  socow_vector<T, SMALL_SIZE, growth_policy::doubling, ShareCount> small;
+  socow_vector<chunk_ref, 1, growth_policy::doubling, ShareCount> chunks;
+  std::size_t count = 0;
+
+  bool is_chunked() const noexcept {
+    return !chunks.empty();
+  }
+
+public:
+  using const_iterator = auxiliary::index_iterator<segmented_socow_vector, T, const_reference>;
+
+  segmented_socow_vector() = default;
+
+  std::size_t size() const noexcept {
+    return count;
+  }
+
+  bool empty() const noexcept {
+    return count == 0;
+  }
+
+  const_iterator begin() const noexcept {
+    return {this, 0};
+  }
+
+  const_iterator end() const noexcept {
+    return {this, count};
+  }
+
+  const_reference operator[](std::size_t index) const noexcept {
+    if (!is_chunked()) {
+      return std::as_const(small)[index];
+    }
+    return std::as_const(chunks)[index / CHUNK_SIZE].get().data[index % CHUNK_SIZE];
+  }
+
+  // copies at most the chunk directory and one chunk
+  reference operator[](std::size_t index) {
+    if (!is_chunked()) {
+      return small[index];
+    }
+    return chunks[index / CHUNK_SIZE].unshared().data[index % CHUNK_SIZE];
+  }
+
+  const_reference at_const(std::size_t index) const {
+    if (index >= size()) {
+      throw std::out_of_range("segmented_socow_vector index out of range");
+    }
+    return (*this)[index];
+  }
+
+  const_reference front() const noexcept {
+    return (*this)[0];
+  }
+
+  const_reference back() const noexcept {
+    return (*this)[count - 1];
+  }
+
+private:
+  void migrate_to_chunks() {
+    chunk_ref first;
+    auto& data = first.unshared();
+
+    std::uninitialized_copy_n(std::as_const(small).begin(), small.size(), data.data);
+    data.size = small.size();
+    chunks.push_back(std::move(first));
+    small.clear();
+    small.shrink_to_fit();
+  }
+
+public:
+  template <typename... Args>
+  void emplace_back(Args&&... args) /* strong */ {
+    if (!is_chunked()) {
+      if (count < SMALL_SIZE) {
+        small.emplace_back(std::forward<Args>(args)...);
+        count++;
+        return;
+      }
+      migrate_to_chunks();
+    }
+
+    bool new_chunk = count % CHUNK_SIZE == 0;
+
+    if (new_chunk) {
+      chunks.emplace_back();
+    }
+    try {
+      auto& last = chunks.back().unshared();
+
+      std::construct_at(last.data + last.size, std::forward<Args>(args)...);
+      last.size++;
+    } catch (...) {
+      if (new_chunk) {
+        chunks.pop_back();
+      }
+      throw;
+    }
+    count++;
+  }
+
+  void push_back(const T& elem) /* strong */ {
+    emplace_back(elem);
+  }
+
+  void push_back(T&& elem) /* strong */ {
+    emplace_back(std::move(elem));
+  }
+
+  void pop_back() /* strong */ {
+    if (!is_chunked()) {
+      small.pop_back();
+    } else {
+      auto& last = chunks.back().unshared();
+
+      std::destroy_at(last.data + --last.size);
+      if (last.size == 0) {
+        chunks.pop_back();
+      }
+    }
+    count--;
+  }
+
+  void clear() noexcept {
+    small.clear();
+    chunks.clear();
+    count = 0;
+  }
+
+  void swap(segmented_socow_vector& other) noexcept {
+    small.swap(other.small);
+    chunks.swap(other.chunks);
+    std::swap(count, other.count);
+  }
+
+  friend void swap(segmented_socow_vector& left, segmented_socow_vector& right) noexcept {
+    left.swap(right);
+  }
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Policies of socow_vector's buffer owners counter.
+// Counter is created equal to 1, decrement() returns true for the last owner.
+namespace share_count_policy {
+class single_threaded {
+private:
+  std::size_t count = 1;
+
+public:
+  single_threaded() = default;
+  single_threaded(const single_threaded&) = delete;
+  single_threaded& operator=(const single_threaded&) = delete;
+
+  bool unique() const noexcept {
+    return count == 1;
+  }
+
+  void increment() noexcept {
+    ++count;
+  }
+
+  bool decrement() noexcept {
+    return --count == 0;
+  }
+};
+
+class thread_safe {
+private:
+  std::atomic<std::size_t> count = 1;
+
+public:
+  thread_safe() = default;
+  thread_safe(const thread_safe&) = delete;
+  thread_safe& operator=(const thread_safe&) = delete;
+
+  // new owners are only made by copying an existing owner, so unique() can't become false behind our back
+  bool unique() const noexcept {
+    return count.load(std::memory_order_acquire) == 1;
+  }
+
+  void increment() noexcept {
+    count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  bool decrement() noexcept {
+    if (unique()) {
+      return true;
+    }
+    return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+};
+} // namespace share_count_policy
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Search and comparison kernels over arrays of arithmetic types. A register is compared
+// bytewise, then the byte mask is reduced to one bit per element; tails are scalar.
+namespace auxiliary::simd {
+#if defined(__AVX2__) || defined(__SSE2__)
+#if defined(__AVX2__)
+using reg = __m256i;
+
+inline reg load(const void* ptr) noexcept {
+  return _mm256_loadu_si256(static_cast<const reg*>(ptr));
+}
+
+template <typename T>
+std::uint32_t equal_bytes(reg a, reg b) noexcept {
+  reg eq;
+
+  if constexpr (std::is_same_v<T, float>) {
+    eq = _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _CMP_EQ_OQ));
+  } else if constexpr (std::is_same_v<T, double>) {
+    eq = _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), _CMP_EQ_OQ));
+  } else if constexpr (sizeof(T) == 1) {
+    eq = _mm256_cmpeq_epi8(a, b);
+  } else if constexpr (sizeof(T) == 2) {
+    eq = _mm256_cmpeq_epi16(a, b);
+  } else if constexpr (sizeof(T) == 4) {
+    eq = _mm256_cmpeq_epi32(a, b);
+  } else {
+    eq = _mm256_cmpeq_epi64(a, b);
+  }
+  return static_cast<std::uint32_t>(_mm256_movemask_epi8(eq));
+}
+#else
+using reg = __m128i;
+
+inline reg load(const void* ptr) noexcept {
+  return _mm_loadu_si128(static_cast<const reg*>(ptr));
+}
+
+// SSE2 has no 64-bit integer compare, the halves are combined by element_mask
+template <typename T>
+std::uint32_t equal_bytes(reg a, reg b) noexcept {
+  reg eq;
+
+  if constexpr (std::is_same_v<T, float>) {
+    eq = _mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+  } else if constexpr (std::is_same_v<T, double>) {
+    eq = _mm_castpd_si128(_mm_cmpeq_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+  } else if constexpr (sizeof(T) == 1) {
+    eq = _mm_cmpeq_epi8(a, b);
+  } else if constexpr (sizeof(T) == 2) {
+    eq = _mm_cmpeq_epi16(a, b);
+  } else {
+    eq = _mm_cmpeq_epi32(a, b);
+  }
+  return static_cast<std::uint32_t>(_mm_movemask_epi8(eq));
+}
+#endif
+
+inline constexpr std::size_t WIDTH = sizeof(reg);
+
+template <typename T>
+inline constexpr bool VECTORIZED =
+    std::is_arithmetic_v<T> && (std::is_integral_v<T> || std::is_same_v<T, float> || std::is_same_v<T, double>) &&
+    WIDTH % sizeof(T) == 0;
+
+// lowest bit of every element is set
+template <typename T>
+inline constexpr std::uint32_t ELEMENT_BITS = ~std::uint32_t(0) / ((std::uint64_t(1) << sizeof(T)) - 1);
+
+inline constexpr std::uint32_t ALL_BYTES = static_cast<std::uint32_t>((std::uint64_t(1) << WIDTH) - 1);
+
+// one bit per element whose bytes are all equal
+template <typename T>
+std::uint32_t element_mask(std::uint32_t bytes) noexcept {
+  for (std::size_t i = 1; i < sizeof(T); i++) {
+    bytes &= bytes >> 1;
+  }
+  return bytes & ELEMENT_BITS<T>;
+}
+
+template <typename T>
+reg splat(T value) noexcept {
+  T lanes[WIDTH / sizeof(T)];
+
+  std::fill_n(lanes, WIDTH / sizeof(T), value);
+  return load(lanes);
+}
+#else
+template <typename T>
+inline constexpr bool VECTORIZED = false;
+#endif
+
+template <typename T>
+std::size_t find(const T* data, std::size_t size, T value) noexcept {
+  std::size_t i = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+  if constexpr (VECTORIZED<T>) {
+    reg pattern = splat(value);
+
+    for (; i + WIDTH / sizeof(T) <= size; i += WIDTH / sizeof(T)) {
+      std::uint32_t found = element_mask<T>(equal_bytes<T>(load(data + i), pattern));
+
+      if (found != 0) {
+        return i + std::countr_zero(found) / sizeof(T);
+      }
+    }
+  }
+#endif
+  for (; i < size; i++) {
+    if (data[i] == value) {
+      return i;
+    }
+  }
+  return size;
+}
+
+template <typename T>
+std::size_t count(const T* data, std::size_t size, T value) noexcept {
+  std::size_t i = 0;
+  std::size_t res = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+  if constexpr (VECTORIZED<T>) {
+    reg pattern = splat(value);
+
+    for (; i + WIDTH / sizeof(T) <= size; i += WIDTH / sizeof(T)) {
+      res += std::popcount(element_mask<T>(equal_bytes<T>(load(data + i), pattern)));
+    }
+  }
+#endif
+  for (; i < size; i++) {
+    res += data[i] == value;
+  }
+  return res;
+}
+
+// index of the first pair of elements that aren't equal, or size
+template <typename T>
+std::size_t mismatch(const T* left, const T* right, std::size_t size) noexcept {
+  std::size_t i = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+  if constexpr (VECTORIZED<T>) {
+    for (; i + WIDTH / sizeof(T) <= size; i += WIDTH / sizeof(T)) {
+      std::uint32_t same = element_mask<T>(equal_bytes<T>(load(left + i), load(right + i)));
+      std::uint32_t differ = ~same & ELEMENT_BITS<T> & ALL_BYTES;
+
+      if (differ != 0) {
+        return i + std::countr_zero(differ) / sizeof(T);
+      }
+    }
+  }
+#endif
+  for (; i < size && left[i] == right[i]; i++) {}
+  return i;
+}
+
+template <typename T>
+bool equal(const T* left, const T* right, std::size_t size) noexcept {
+  if constexpr (std::is_integral_v<T>) {
+    return size == 0 || std::memcmp(left, right, size * sizeof(T)) == 0;
+  } else {
+    return mismatch(left, right, size) == size;
+  }
+}
+
+template <typename T>
+auto compare_three_way(const T* left, std::size_t left_size, const T* right, std::size_t right_size) noexcept {
+  std::size_t common = std::min(left_size, right_size);
+  std::size_t i = mismatch(left, right, common);
+
+  if (i < common) {
+    return std::compare_three_way_result_t<T>(left[i] <=> right[i]);
+  }
+  return std::compare_three_way_result_t<T>(left_size <=> right_size);
+}
+} // namespace auxiliary::simd
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "index-iterator.h"
+#include "socow-vector.h"
+
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+// Structure of arrays: every field lives in its own socow_vector column, so copies share
+// all columns and a write unshares only the columns it touches. Rows are accessed
+// through tuples of references.
+template <std::size_t SMALL_SIZE, typename... Fields>
+  requires (sizeof...(Fields) > 0)
+class socow_soa {
+public:
+  using value_type = std::tuple<Fields...>;
+  using reference = std::tuple<Fields&...>;
+  using const_reference = std::tuple<const Fields&...>;
+
+  template <std::size_t I>
+  using field_type = std::tuple_element_t<I, value_type>;
+
+  template <std::size_t I>
+  using column_type = socow_vector<field_type<I>, SMALL_SIZE>;
+
+private:
+  using indices = std::index_sequence_for<Fields...>;
+
+  std::tuple<socow_vector<Fields, SMALL_SIZE>...> columns;
+
+public:
+  using const_iterator = auxiliary::index_iterator<socow_soa, value_type, const_reference>;
+
+  socow_soa() = default;
+
+  std::size_t size() const noexcept {
+    return std::get<0>(columns).size();
+  }
+
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  const_iterator begin() const noexcept {
+    return {this, 0};
+  }
+
+  const_iterator end() const noexcept {
+    return {this, size()};
+  }
+
+  /*** Columns ***/
+
+  // copying the column out shares its buffer
+  template <std::size_t I>
+  const column_type<I>& column() const noexcept {
+    return std::get<I>(columns);
+  }
+
+  template <std::size_t I>
+  std::span<const field_type<I>> cview() const noexcept {
+    return std::get<I>(columns).cview();
+  }
+
+  // unshares the I-th column only
+  template <std::size_t I>
+  std::span<field_type<I>> mutate() {
+    return std::get<I>(columns).mutate();
+  }
+
+  /*** Rows ***/
+
+  const_reference operator[](std::size_t index) const noexcept {
+    return std::apply(
+        [index](const auto&... column) { return const_reference(std::as_const(column)[index]...); },
+        columns
+    );
+  }
+
+  // unshares every column, prefer mutate<I>() to write one field
+  reference operator[](std::size_t index) {
+    return std::apply([index](auto&... column) { return reference(column[index]...); }, columns);
+  }
+
+  const_reference at_const(std::size_t index) const {
+    if (index >= size()) {
+      throw std::out_of_range("socow_soa index out of range");
+    }
+    return (*this)[index];
+  }
+
+  const_reference front() const noexcept {
+    return (*this)[0];
+  }
+
+  const_reference back() const noexcept {
+    return (*this)[size() - 1];
+  }
+
+private:
+  template <std::size_t... I, typename... Args>
+  void emplace_back_fields(std::index_sequence<I...>, Args&&... args) {
+    std::size_t pushed = 0;
+
+    try {
+      ((std::get<I>(columns).emplace_back(std::forward<Args>(args)), pushed++), ...);
+    } catch (...) {
+      ((I < pushed ? std::get<I>(columns).pop_back() : void()), ...);
+      throw;
+    }
+  }
+
+public:
+  void reserve(std::size_t new_capacity) /* basic */ {
+    std::apply([new_capacity](auto&... column) { (column.reserve(new_capacity), ...); }, columns);
+  }
+
+  // one argument per field
+  template <typename... Args>
+    requires (sizeof...(Args) == sizeof...(Fields))
+  void emplace_back(Args&&... args) /* strong */ {
+    emplace_back_fields(indices(), std::forward<Args>(args)...);
+  }
+
+  void push_back(const value_type& row) /* strong */ {
+    std::apply([this](const auto&... fields) { emplace_back(fields...); }, row);
+  }
+
+  void push_back(value_type&& row) /* strong */ {
+    std::apply([this](auto&... fields) { emplace_back(std::move(fields)...); }, row);
+  }
+
+  void pop_back() /* basic */ {
+    std::apply([](auto&... column) { (column.pop_back(), ...); }, columns);
+  }
+
+  void clear() noexcept {
+    std::apply([](auto&... column) { (column.clear(), ...); }, columns);
+  }
+
+  void swap(socow_soa& other) noexcept {
+    columns.swap(other.columns);
+  }
+
+  friend void swap(socow_soa& left, socow_soa& right) noexcept {
+    left.swap(right);
+  }
+};
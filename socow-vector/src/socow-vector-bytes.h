@@ -0,0 +1,52 @@
+#pragma once
+
+#include "socow-vector.h"
+
+#include <cstddef>
+#include <type_traits>
+
+namespace auxiliary {
+// largest N <= UPPER such that sizeof(socow_vector<T, N, Policies...>) <= BYTES, or 0 if none
+template <typename T, std::size_t BYTES, std::size_t UPPER, typename... Policies>
+struct fitting_small_size
+    : std::conditional_t<
+          (sizeof(socow_vector<T, UPPER, Policies...>) <= BYTES),
+          std::integral_constant<std::size_t, UPPER>,
+          fitting_small_size<T, BYTES, UPPER - 1, Policies...>> {};
+
+template <typename T, std::size_t BYTES, typename... Policies>
+struct fitting_small_size<T, BYTES, 0, Policies...> : std::integral_constant<std::size_t, 0> {};
+
+template <typename T, std::size_t BYTES, typename... Policies>
+struct small_size_for_bytes {
+  // the layout bounds the inline elements by its own header and limits; padding can only
+  // take a few more, so the search below is short
+  static constexpr std::size_t UPPER =
+      socow_vector<T, 1, Policies...>::layout_type::template max_small_size<T>(BYTES);
+  static constexpr std::size_t value = fitting_small_size<T, BYTES, UPPER, Policies...>::value;
+
+  static_assert(value > 0, "socow_vector with a single inline element doesn't fit in BYTES");
+};
+} // namespace auxiliary
+
+// socow_vector with as many inline elements as fit in an object of BYTES bytes
+template <typename T, std::size_t BYTES = 64, typename... Policies>
+using socow_vector_bytes =
+    socow_vector<T, auxiliary::small_size_for_bytes<T, BYTES, Policies...>::value, Policies...>;
+
+// compile-time layout report of a socow_vector instantiation
+template <typename Vector>
+struct socow_layout;
+
+template <typename T, std::size_t SMALL_SIZE, typename... Policies>
+struct socow_layout<socow_vector<T, SMALL_SIZE, Policies...>> {
+  static constexpr std::size_t CACHE_LINE = 64;
+
+  static constexpr std::size_t object_size = sizeof(socow_vector<T, SMALL_SIZE, Policies...>);
+  static constexpr std::size_t object_align = alignof(socow_vector<T, SMALL_SIZE, Policies...>);
+  static constexpr std::size_t small_size = SMALL_SIZE;
+  static constexpr std::size_t inline_bytes = SMALL_SIZE * sizeof(T);
+  static constexpr std::size_t overhead_bytes = object_size - inline_bytes;
+  static constexpr std::size_t cache_lines = (object_size + CACHE_LINE - 1) / CACHE_LINE;
+  static constexpr bool fits_cache_line = object_size <= CACHE_LINE;
+};
@@ -1,16 +1,45 @@
 #pragma once
 
-#include "size-state.h"
+#include "growth-policy.h"
+#include "large-copy.h"
+#include "layout-policy.h"
+#include "mapped-file.h"
+#include "reflexive-equality.h"
+#include "share-count.h"
+#include "simd-search.h"
+#include "trivially-relocatable.h"
+#include "unshare-stats.h"
 
 #include <algorithm>
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <memory_resource>
+#include <new>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
 
-template <typename T, std::size_t SMALL_SIZE>
+template <
+    typename T,
+    std::size_t SMALL_SIZE,
+    typename Growth = growth_policy::doubling,
+    typename ShareCount = share_count_policy::single_threaded,
+    typename Allocator = std::allocator<T>,
+    typename Layout = layout_policy::split>
   requires (SMALL_SIZE > 0)
 class socow_vector {
 public:
   using value_type = T;
+  using allocator_type = Allocator;
+  using layout_type = Layout;
   using iterator = T*;
   using const_iterator = const T*;
   using pointer = T*;
@@ -19,21 +48,93 @@ public:
   using const_reference = const T&;
 
 private:
+  struct buffer;
+
+  using alloc_traits = std::allocator_traits<Allocator>;
+  using buffer_allocator = typename alloc_traits::template rebind_alloc<buffer>;
+  using buffer_alloc_traits = typename alloc_traits::template rebind_traits<buffer>;
+
+  // default allocator is served by malloc, so that buffers can grow by realloc
+  static constexpr bool USES_MALLOC = std::is_same_v<Allocator, std::allocator<T>>;
+
+  // allocator is kept in the buffer, so the last owner of a shared buffer frees it with the right one
   struct buffer {
     std::size_t capacity;
-    std::size_t share_count;
+    ShareCount share_count;
+#ifdef _MSC_VER
+    [[msvc::no_unique_address]]
+#else
+    [[no_unique_address]]
+#endif
+    buffer_allocator alloc;
+#ifdef _MSC_VER
+    [[msvc::no_unique_address]]
+#else
+    [[no_unique_address]]
+#endif
+    typename Layout::buffer_size size;
     value_type data[0];
 
-    [[nodiscard]] static buffer* allocate(std::size_t capacity) {
-      buffer* buf = static_cast<buffer*>(operator new(sizeof(buffer) + capacity * sizeof(value_type)));
+    static std::size_t bytes(std::size_t capacity) {
+      if (capacity > (std::numeric_limits<std::size_t>::max() - sizeof(buffer)) / sizeof(value_type)) {
+        throw std::bad_alloc();
+      }
+      return sizeof(buffer) + capacity * sizeof(value_type);
+    }
+
+    // memory is allocated in whole buffers to keep alignment of the header and data
+    static std::size_t units(std::size_t capacity) {
+      return (bytes(capacity) + sizeof(buffer) - 1) / sizeof(buffer);
+    }
+
+    [[nodiscard]] static buffer* allocate(const Allocator& alloc, std::size_t capacity) {
+      buffer* buf;
+
+      if constexpr (USES_MALLOC) {
+        buf = static_cast<buffer*>(std::malloc(bytes(capacity)));
+        if (buf == nullptr) {
+          throw std::bad_alloc();
+        }
+      } else {
+        buffer_allocator balloc(alloc);
+
+        buf = buffer_alloc_traits::allocate(balloc, units(capacity));
+      }
+      return construct(buf, alloc, capacity);
+    }
+
+    // header in raw memory, deallocate() frees the memory with alloc
+    static buffer* construct(void* place, const Allocator& alloc, std::size_t capacity) noexcept {
+      buffer* buf = static_cast<buffer*>(place);
 
       buf->capacity = capacity;
-      buf->share_count = 1;
+      std::construct_at(&buf->share_count);
+      std::construct_at(&buf->alloc, alloc);
+      std::construct_at(&buf->size);
       return buf;
     }
 
+    // pre: USES_MALLOC, share_count is unique, value_type is trivially relocatable
+    [[nodiscard]] static buffer* reallocate(buffer* buf, std::size_t capacity) {
+      buffer* res = static_cast<buffer*>(std::realloc(static_cast<void*>(buf), bytes(capacity)));
+
+      if (res == nullptr) {
+        throw std::bad_alloc();
+      }
+      res->capacity = capacity;
+      return res;
+    }
+
     static void deallocate(buffer* buf) noexcept {
-      operator delete(static_cast<void*>(buf));
+      buffer_allocator balloc(std::move(buf->alloc));
+
+      std::destroy_at(&buf->alloc);
+      std::destroy_at(&buf->share_count);
+      if constexpr (USES_MALLOC) {
+        std::free(buf);
+      } else {
+        buffer_alloc_traits::deallocate(balloc, buf, units(buf->capacity));
+      }
     }
 
     buffer(const buffer& other) = delete;
@@ -43,15 +144,27 @@ private:
     ~buffer() = default;
   };
 
-  auxiliary::size_state info;
-
-  using static_buffer_t = T[SMALL_SIZE];
   using dynamic_buffer_t = buffer*;
 
-  union {
-    static_buffer_t sbuf;
-    dynamic_buffer_t dbuf;
-  };
+  typename Layout::template storage<T, SMALL_SIZE, buffer> state;
+#ifdef _MSC_VER
+  [[msvc::no_unique_address]]
+#else
+  [[no_unique_address]]
+#endif
+  Allocator alloc;
+
+  pointer sbuf() noexcept {
+    return state.sbuf();
+  }
+
+  const_pointer sbuf() const noexcept {
+    return state.sbuf();
+  }
+
+  dynamic_buffer_t dbuf() const noexcept {
+    return state.dbuf();
+  }
 
   struct buffer_safe_pointer {
     std::size_t size = 0;
@@ -83,28 +196,31 @@ private:
   };
 
 public:
-  socow_vector()
-    : info() {}
+  socow_vector() = default;
+
+  explicit socow_vector(const Allocator& alloc)
+    : alloc(alloc) {}
 
   socow_vector(const socow_vector& other)
-    : info(other.info) {
-    if (other.info.is_static()) {
-      std::uninitialized_copy_n(other.sbuf, other.size(), sbuf);
+    : alloc(alloc_traits::select_on_container_copy_construction(other.alloc)) {
+    if (other.state.is_static()) {
+      std::uninitialized_copy_n(other.sbuf(), other.size(), sbuf());
+      state.set_static(other.size());
     } else {
-      dbuf = other.dbuf;
-      dbuf->share_count++;
+      other.dbuf()->share_count.increment();
+      state.set_dynamic(other.dbuf(), other.size());
     }
   }
 
   socow_vector(socow_vector&& other) noexcept
-    : info(other.info) {
-    if (other.info.is_static()) {
-      std::uninitialized_move_n(other.sbuf, other.size(), sbuf);
+    : alloc(other.alloc) {
+    if (other.state.is_static()) {
+      relocate_n(other.sbuf(), other.size(), sbuf());
+      state.set_static(other.size());
     } else {
-      dbuf = other.dbuf;
-      dbuf->share_count++;
+      state.set_dynamic(other.dbuf(), other.size());
     }
-    other.clear();
+    other.state.reset();
   }
 
   socow_vector& operator=(const socow_vector& other) & {
@@ -126,54 +242,98 @@ public:
   }
 
 private:
+  static constexpr bool RELOCATABLE = is_trivially_relocatable_v<T>;
+
+  static std::byte* as_bytes(pointer ptr) noexcept {
+    return reinterpret_cast<std::byte*>(ptr);
+  }
+
+  // moves count elements to uninitialized memory and ends lifetime of the originals
+  static void relocate_n(pointer from, std::size_t count, pointer to) {
+    if constexpr (RELOCATABLE) {
+      std::memcpy(as_bytes(to), as_bytes(from), count * sizeof(T));
+    } else {
+      std::uninitialized_move_n(from, count, to);
+      std::destroy_n(from, count);
+    }
+  }
+
+  // copies elements of a shared buffer, big trivially copyable ones in parallel
+  static void copy_shared_n(const_pointer from, std::size_t count, pointer to) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      auxiliary::large_copy::copy(to, from, count * sizeof(T));
+    } else {
+      std::uninitialized_copy_n(from, count, to);
+    }
+  }
+
   static void
   swap_raw_arrays(pointer small_arr, pointer big_arr, std::size_t swap_size, std::size_t full_size) noexcept {
-    std::swap_ranges(small_arr, small_arr + swap_size, big_arr);
-    std::uninitialized_move_n(big_arr + swap_size, full_size - swap_size, small_arr + swap_size);
-    std::destroy_n(big_arr + swap_size, full_size - swap_size);
+    if constexpr (RELOCATABLE) {
+      std::swap_ranges(as_bytes(small_arr), as_bytes(small_arr + swap_size), as_bytes(big_arr));
+    } else {
+      std::swap_ranges(small_arr, small_arr + swap_size, big_arr);
+    }
+    relocate_n(big_arr + swap_size, full_size - swap_size, small_arr + swap_size);
   }
 
-public:
-  void swap(socow_vector& other) noexcept {
-    if (this == &other) {
-      return;
-    }
+  void swap_storage(socow_vector& other) noexcept {
+    std::size_t this_size = size();
+    std::size_t other_size = other.size();
 
-    if (info.is_static()) {
-      if (other.info.is_static()) {
-        if (size() <= other.size()) { // case 1
-          swap_raw_arrays(sbuf, other.sbuf, size(), other.size());
-          std::swap(info, other.info);
+    if (state.is_static()) {
+      if (other.state.is_static()) {
+        if (this_size <= other_size) { // case 1
+          swap_raw_arrays(sbuf(), other.sbuf(), this_size, other_size);
+          state.set_static(other_size);
+          other.state.set_static(this_size);
         } else { // also case 1
-          other.swap(*this);
+          other.swap_storage(*this);
         }
       } else { // case 2
-        dynamic_buffer_t tmp = other.dbuf;
+        dynamic_buffer_t tmp = other.dbuf();
 
-        swap_raw_arrays(other.sbuf, sbuf, 0, size());
-        dbuf = tmp;
-        std::swap(info, other.info);
+        swap_raw_arrays(other.sbuf(), sbuf(), 0, this_size);
+        other.state.set_static(this_size);
+        state.set_dynamic(tmp, other_size);
       }
     } else {
-      if (other.info.is_static()) { // also case 2
-        other.swap(*this);
+      if (other.state.is_static()) { // also case 2
+        other.swap_storage(*this);
       } else {
-        std::swap(dbuf, other.dbuf);
-        std::swap(info, other.info);
+        dynamic_buffer_t tmp = dbuf();
+
+        state.set_dynamic(other.dbuf(), other_size);
+        other.state.set_dynamic(tmp, this_size);
       }
     }
   }
 
+public:
+  void swap(socow_vector& other) noexcept {
+    if (this == &other) {
+      return;
+    }
+    if constexpr (alloc_traits::propagate_on_container_swap::value) {
+      std::swap(alloc, other.alloc);
+    }
+    swap_storage(other);
+  }
+
+  allocator_type get_allocator() const noexcept {
+    return alloc;
+  }
+
   friend void swap(socow_vector& left, socow_vector& right) noexcept {
     left.swap(right);
   }
 
   std::size_t size() const noexcept {
-    return info.size();
+    return state.size();
   }
 
   std::size_t capacity() const noexcept {
-    return info.is_static() ? SMALL_SIZE : dbuf->capacity;
+    return state.is_static() ? SMALL_SIZE : dbuf()->capacity;
   }
 
   bool empty() const noexcept {
@@ -181,27 +341,37 @@ public:
   }
 
 private:
+  // memory of the buffer mustn't be written, e.g. it's a read-only mapped file
+  static bool is_read_only(const buffer* buf) noexcept {
+    if constexpr (requires { buf->alloc.read_only(); }) {
+      return buf->alloc.read_only();
+    } else {
+      return false;
+    }
+  }
+
+  // read-only buffers are treated as shared, so every change copies them
   bool is_shared() const noexcept {
-    return info.is_dynamic() && dbuf->share_count > 1;
+    return state.is_dynamic() && (!dbuf()->share_count.unique() || is_read_only(dbuf()));
   }
 
 public:
   /*** Iterators ***/
   iterator begin() {
-    if (info.is_static()) {
-      return sbuf;
+    if (state.is_static()) {
+      return sbuf();
     }
     if (is_shared()) {
       forced_update_to_capacity(capacity());
     }
-    return dbuf->data;
+    return dbuf()->data;
   }
 
   const_iterator begin() const noexcept {
-    if (info.is_static()) {
-      return sbuf;
+    if (state.is_static()) {
+      return sbuf();
     }
-    return dbuf->data;
+    return dbuf()->data;
   }
 
   pointer data() {
@@ -244,6 +414,97 @@ public:
     return *(end() - 1);
   }
 
+  /*** Read-only access, never unshares ***/
+  const_iterator cbegin() const noexcept {
+    return begin();
+  }
+
+  const_iterator cend() const noexcept {
+    return end();
+  }
+
+  std::span<const value_type> cview() const noexcept {
+    return {begin(), size()};
+  }
+
+  const_reference at_const(std::size_t index) const {
+    if (index >= size()) {
+      throw std::out_of_range("socow_vector index out of range");
+    }
+    return *(begin() + index);
+  }
+
+  // unshares once, the view stays valid until the next change of size or capacity
+  std::span<value_type> mutate() {
+    return {begin(), size()};
+  }
+
+  /*** Search and comparison, never unshare ***/
+private:
+  // copies sharing a buffer are equal without looking at the elements, if every element is
+  // equal to itself
+  static constexpr bool SAME_BUFFER_IS_EQUAL = has_reflexive_equality_v<T>;
+
+  bool same_buffer(const socow_vector& other) const noexcept {
+    return this == &other || (state.is_dynamic() && other.state.is_dynamic() && dbuf() == other.dbuf());
+  }
+
+public:
+  const_iterator find(const value_type& elem) const {
+    if constexpr (std::is_arithmetic_v<T>) {
+      return begin() + auxiliary::simd::find(begin(), size(), elem);
+    } else {
+      return std::find(begin(), end(), elem);
+    }
+  }
+
+  std::size_t count(const value_type& elem) const {
+    if constexpr (std::is_arithmetic_v<T>) {
+      return auxiliary::simd::count(begin(), size(), elem);
+    } else {
+      return std::count(begin(), end(), elem);
+    }
+  }
+
+  bool contains(const value_type& elem) const {
+    return find(elem) != end();
+  }
+
+  friend bool operator==(const socow_vector& left, const socow_vector& right)
+    requires std::equality_comparable<T>
+  {
+    if (left.size() != right.size()) {
+      return false;
+    }
+    if constexpr (SAME_BUFFER_IS_EQUAL) {
+      if (left.same_buffer(right)) {
+        return true;
+      }
+    }
+    if constexpr (std::is_arithmetic_v<T>) {
+      return auxiliary::simd::equal(left.begin(), right.begin(), left.size());
+    } else {
+      return std::equal(left.begin(), left.end(), right.begin());
+    }
+  }
+
+  friend auto operator<=>(const socow_vector& left, const socow_vector& right)
+    requires std::three_way_comparable<T>
+  {
+    using ordering = std::compare_three_way_result_t<T>;
+
+    if constexpr (SAME_BUFFER_IS_EQUAL) {
+      if (left.same_buffer(right)) {
+        return ordering(std::strong_ordering::equal);
+      }
+    }
+    if constexpr (std::is_arithmetic_v<T>) {
+      return auxiliary::simd::compare_three_way(left.begin(), left.size(), right.begin(), right.size());
+    } else {
+      return ordering(std::lexicographical_compare_three_way(left.begin(), left.end(), right.begin(), right.end()));
+    }
+  }
+
   /*** Iterators ***/
 
 public:
@@ -254,97 +515,237 @@ public:
   }
 
   /*** Element adding methods ***/
+  // through insert, so elem gets its value back if the vector can't grow
   void push_back(T&& elem) /* strong */ {
     insert(std::as_const(*this).end(), std::move(elem));
   }
 
   void push_back(const T& elem) /* strong */ {
-    insert(std::as_const(*this).end(), elem);
+    emplace_back(elem);
   }
 
 private:
   iterator unchanging_begin() {
-    if (info.is_static()) {
-      return sbuf;
+    if (state.is_static()) {
+      return sbuf();
     }
-    return dbuf->data;
+    return dbuf()->data;
   }
 
-  template <typename V>
-  void insert_swapping(const_iterator pos, V&& elem) {
-    iterator cur = end();
+  std::size_t grown_capacity(std::size_t new_size) const noexcept {
+    if (new_size <= capacity()) {
+      return capacity();
+    }
+    return Growth::grow(capacity(), new_size, sizeof(value_type), sizeof(buffer));
+  }
+
+  bool can_grow_in_place() const noexcept {
+    return state.is_dynamic() && !is_shared();
+  }
+
+  // pre: place < last, last is constructed
+  static void shift_one(iterator place, iterator last) {
+    if constexpr (RELOCATABLE) {
+      alignas(T) std::byte tmp[sizeof(T)];
+
+      std::memcpy(tmp, as_bytes(last), sizeof(T));
+      std::memmove(as_bytes(place + 1), as_bytes(place), (last - place) * sizeof(T));
+      std::memcpy(as_bytes(place), tmp, sizeof(T));
+    } else {
+      try {
+        T tmp(std::move(*last));
 
-    std::construct_at(cur, std::forward<V>(elem));
-    while (cur-- != pos) {
-      std::iter_swap(cur, cur + 1);
+        std::move_backward(place, last, last + 1);
+        *place = std::move(tmp);
+      } catch (...) {
+        std::destroy_at(last);
+        throw;
+      }
     }
   }
 
-  template <typename V>
-  void insert_moving(std::size_t ind, V&& elem) {
-    buffer_safe_pointer tmp(buffer::allocate(capacity() == size() ? 2 * capacity() : capacity()));
+  // pre: !is_shared(), size() + count <= capacity()
+  template <typename Fill>
+  void insert_n_shifting(std::size_t ind, std::size_t count, Fill fill) {
+    iterator place = unchanging_begin() + ind;
+    iterator last = unchanging_begin() + size();
 
-    std::construct_at(tmp->data + ind, std::forward<V>(elem));
-    std::uninitialized_move_n(unchanging_begin(), ind, tmp->data);
-    std::uninitialized_move_n(unchanging_begin() + ind, size() - ind, tmp->data + ind + 1);
-    std::destroy_n(unchanging_begin(), size());
-    if (info.is_dynamic()) {
-      buffer::deallocate(dbuf);
+    fill(last);
+    if (place == last) {
+      return;
+    }
+    if (count == 1) {
+      shift_one(place, last);
     } else {
-      info.make_dyamic();
+      std::rotate(place, last, last + count);
     }
-    dbuf = tmp.release();
   }
 
-public:
-  iterator insert(const_iterator pos, value_type&& elem) /* strong */ {
-    std::size_t ind = pos - std::as_const(*this).begin();
-    bool expand = size() == capacity();
+  template <typename Fill, typename Unfill>
+  void insert_n_relocating(std::size_t ind, std::size_t count, std::size_t new_capacity, Fill fill, Unfill unfill) {
+    buffer_safe_pointer tmp(buffer::allocate(alloc, new_capacity));
+
+    fill(tmp->data + ind);
+    try {
+      if (is_shared()) {
+        copy_shared_n(dbuf()->data, ind, tmp->data);
+        tmp.size += ind;
+        copy_shared_n(dbuf()->data + ind, size() - ind, tmp->data + ind + count);
+        auxiliary::unshare_counter::record(size());
+      } else if constexpr (RELOCATABLE) {
+        relocate_n(unchanging_begin(), ind, tmp->data);
+        relocate_n(unchanging_begin() + ind, size() - ind, tmp->data + ind + count);
+      } else {
+        std::uninitialized_move_n(unchanging_begin(), ind, tmp->data);
+        std::uninitialized_move_n(unchanging_begin() + ind, size() - ind, tmp->data + ind + count);
+      }
+    } catch (...) {
+      unfill(tmp->data + ind);
+      throw;
+    }
+    std::size_t old_size = size();
 
     if (is_shared()) {
-      buffer_safe_pointer tmp(buffer::allocate(expand ? 2 * capacity() : capacity()));
+      detach_buffer(dbuf());
+    } else {
+      if constexpr (!RELOCATABLE) {
+        std::destroy_n(unchanging_begin(), old_size);
+      }
+      if (state.is_dynamic()) {
+        buffer::deallocate(dbuf());
+      }
+    }
+    state.set_dynamic(tmp.release(), old_size);
+  }
 
-      std::construct_at(tmp->data + ind, std::move(elem));
-      try {
-        std::uninitialized_copy_n(dbuf->data, ind, tmp->data);
-        tmp.size += ind;
-        std::uninitialized_copy_n(dbuf->data + ind, size() - ind, tmp->data + ind + 1);
-      } catch (...) {
-        elem = std::move(tmp->data[ind]);
-        std::destroy_at(tmp->data + ind);
-        throw;
+  // fill(pointer) constructs exactly count elements in uninitialized memory,
+  // unfill(pointer) destroys them if the rest of the buffer can't be copied
+  template <typename Fill, typename Unfill>
+  void insert_n(std::size_t ind, std::size_t count, Fill fill, Unfill unfill) /* strong */ {
+    if (count == 0) {
+      return;
+    }
+
+    std::size_t new_size = size() + count;
+
+    if constexpr (USES_MALLOC && RELOCATABLE) {
+      // fill may read from the current buffer, so the new element is built before realloc
+      if (count == 1 && new_size > capacity() && can_grow_in_place()) {
+        alignas(T) std::byte elem[sizeof(T)];
+
+        fill(reinterpret_cast<pointer>(elem));
+        try {
+          state.set_dynamic(buffer::reallocate(dbuf(), grown_capacity(new_size)), new_size - 1);
+        } catch (...) {
+          // the buffer is untouched, only the new element has to be given back
+          unfill(reinterpret_cast<pointer>(elem));
+          throw;
+        }
+        insert_n_shifting(ind, 1, [&](pointer dest) { std::memcpy(as_bytes(dest), elem, sizeof(T)); });
+        state.set_size(new_size);
+        return;
       }
-      detach_buffer(dbuf);
-      dbuf = tmp.release();
-    } else if (expand) {
-      insert_moving(ind, std::move(elem));
+    }
+    if (is_shared() || new_size > capacity()) {
+      insert_n_relocating(ind, count, grown_capacity(new_size), fill, unfill);
     } else {
-      insert_swapping(pos, std::move(elem));
+      insert_n_shifting(ind, count, fill);
     }
-    ++info;
+    state.set_size(new_size);
+  }
+
+  template <typename Fill>
+  void insert_n(std::size_t ind, std::size_t count, Fill fill) /* strong */ {
+    insert_n(ind, count, fill, [count](pointer dest) noexcept { std::destroy_n(dest, count); });
+  }
+
+public:
+  template <typename... Args>
+  iterator emplace(const_iterator pos, Args&&... args) /* strong */ {
+    std::size_t ind = pos - std::as_const(*this).begin();
+
+    insert_n(ind, 1, [&](pointer dest) { std::construct_at(dest, std::forward<Args>(args)...); });
+    return begin() + ind;
+  }
+
+  template <typename... Args>
+  reference emplace_back(Args&&... args) /* strong */ {
+    insert_n(size(), 1, [&](pointer dest) { std::construct_at(dest, std::forward<Args>(args)...); });
+    return *(unchanging_begin() + size() - 1);
+  }
+
+  iterator insert(const_iterator pos, value_type&& elem) /* strong */ {
+    std::size_t ind = pos - std::as_const(*this).begin();
+
+    insert_n(
+        ind,
+        1,
+        [&](pointer dest) { std::construct_at(dest, std::move(elem)); },
+        [&](pointer dest) {
+          elem = std::move(*dest);
+          std::destroy_at(dest);
+        }
+    );
     return begin() + ind;
   }
 
   iterator insert(const_iterator pos, const value_type& elem) /* strong */ {
+    return emplace(pos, elem);
+  }
+
+  iterator insert(const_iterator pos, std::size_t count, const value_type& elem) /* strong */ {
     std::size_t ind = pos - std::as_const(*this).begin();
-    bool expand = size() == capacity();
 
-    if (is_shared()) {
-      buffer_safe_pointer tmp(buffer::allocate(expand ? 2 * capacity() : capacity()));
-
-      std::construct_at(tmp->data + ind, elem);
-      std::uninitialized_copy_n(dbuf->data, ind, tmp->data);
-      tmp.size += ind + 1;
-      std::uninitialized_copy_n(dbuf->data + ind, size() - ind, tmp->data + ind + 1);
-      detach_buffer(dbuf);
-      dbuf = tmp.release();
-    } else if (expand) {
-      insert_moving(ind, elem);
+    insert_n(ind, count, [&](pointer dest) { std::uninitialized_fill_n(dest, count, elem); });
+    return begin() + ind;
+  }
+
+  template <std::forward_iterator It>
+  iterator insert(const_iterator pos, It first, It last) /* strong */ {
+    std::size_t ind = pos - std::as_const(*this).begin();
+    std::size_t count = std::distance(first, last);
+
+    insert_n(ind, count, [&](pointer dest) { std::uninitialized_copy_n(first, count, dest); });
+    return begin() + ind;
+  }
+
+  template <std::ranges::forward_range R>
+  void append_range(R&& range) /* strong */ {
+    std::size_t count = std::ranges::distance(range);
+
+    insert_n(size(), count, [&](pointer dest) {
+      std::ranges::uninitialized_copy_n(std::ranges::begin(range), count, dest, dest + count);
+    });
+  }
+
+  template <std::ranges::input_range R>
+  void append_range(R&& range) /* basic */ {
+    for (auto&& elem : range) {
+      emplace_back(std::forward<decltype(elem)>(elem));
+    }
+  }
+
+  template <std::forward_iterator It>
+  void assign(It first, It last) /* basic */ {
+    std::size_t count = std::distance(first, last);
+
+    if (is_shared() || count > capacity()) {
+      socow_vector tmp(alloc);
+
+      tmp.reserve(count);
+      tmp.insert(std::as_const(tmp).end(), first, last);
+      swap(tmp);
+    } else if (count <= size()) {
+      iterator new_end = std::copy_n(first, count, unchanging_begin());
+
+      std::destroy(new_end, unchanging_begin() + size());
+      state.set_size(count);
     } else {
-      insert_swapping(pos, elem);
+      It mid = std::next(first, size());
+
+      std::uninitialized_copy(mid, last, std::copy(first, mid, unchanging_begin()));
+      state.set_size(count);
     }
-    ++info;
-    return begin() + ind;
   }
 
   /*** End of element adding methods ***/
@@ -357,7 +758,7 @@ public:
 private:
   // pre: size() is correct, no nullptrs
   void detach_buffer(dynamic_buffer_t buf) noexcept {
-    if (--buf->share_count == 0) {
+    if (buf->share_count.decrement()) {
       std::destroy_n(buf->data, size());
       buffer::deallocate(buf);
     }
@@ -365,45 +766,60 @@ private:
 
 private:
   void migrate_to_dynamic(std::size_t new_capacity) {
-    buffer* tmp = buffer::allocate(new_capacity);
+    buffer* tmp = buffer::allocate(alloc, new_capacity);
+    std::size_t count = size();
 
-    std::uninitialized_move_n(sbuf, size(), tmp->data);
-    std::destroy_n(sbuf, size());
-    dbuf = tmp;
-    info.make_dyamic();
+    relocate_n(sbuf(), count, tmp->data);
+    state.set_dynamic(tmp, count);
   }
 
+  // inline elements may overlap the buffer pointer, so it's kept aside
   void migrate_to_static() {
-    dynamic_buffer_t tmp = dbuf;
+    dynamic_buffer_t tmp = dbuf();
+    std::size_t count = size();
 
-    if (tmp->share_count > 1) {
+    if (is_shared()) {
       try {
-        std::uninitialized_copy_n(tmp->data, size(), sbuf); // may throw
+        std::uninitialized_copy_n(tmp->data, count, sbuf()); // may throw
       } catch (...) {
-        dbuf = tmp;
+        state.set_dynamic(tmp, count);
         throw;
       }
+      auxiliary::unshare_counter::record(count);
+      state.set_static(count);
+      detach_buffer(tmp);
     } else {
-      std::uninitialized_move_n(tmp->data, size(), sbuf);
+      relocate_n(tmp->data, count, sbuf());
+      buffer::deallocate(tmp);
+      state.set_static(count);
     }
-    detach_buffer(tmp);
-    info.make_static();
   }
 
   void expand_dynamic_buffer(std::size_t new_capacity) {
-    buffer_safe_pointer tmp(buffer::allocate(new_capacity));
+    std::size_t count = size();
+
+    if constexpr (USES_MALLOC && RELOCATABLE) {
+      if (can_grow_in_place()) {
+        state.set_dynamic(buffer::reallocate(dbuf(), new_capacity), count);
+        return;
+      }
+    }
+
+    buffer_safe_pointer tmp(buffer::allocate(alloc, new_capacity));
 
-    if (dbuf->share_count > 1) {
-      std::uninitialized_copy_n(dbuf->data, size(), tmp->data); // may throw
+    if (is_shared()) {
+      copy_shared_n(dbuf()->data, count, tmp->data); // may throw
+      auxiliary::unshare_counter::record(count);
+      detach_buffer(dbuf());
     } else {
-      std::uninitialized_move_n(dbuf->data, size(), tmp->data);
+      relocate_n(dbuf()->data, count, tmp->data);
+      buffer::deallocate(dbuf());
     }
-    detach_buffer(dbuf);
-    dbuf = tmp.release();
+    state.set_dynamic(tmp.release(), count);
   }
 
   void forced_update_to_capacity(std::size_t new_capacity) /* strong */ {
-    if (info.is_static()) {
+    if (state.is_static()) {
       if (new_capacity > SMALL_SIZE) {
         migrate_to_dynamic(new_capacity);
       }
@@ -426,22 +842,25 @@ public:
     std::size_t new_size = size() - (indl - indf);
 
     if (is_shared()) {
-      buffer_safe_pointer tmp(buffer::allocate(capacity()));
+      buffer_safe_pointer tmp(buffer::allocate(alloc, capacity()));
 
-      std::uninitialized_copy_n(dbuf->data, indf, tmp->data);
+      copy_shared_n(dbuf()->data, indf, tmp->data);
       tmp.size += indf;
-      std::uninitialized_copy_n(dbuf->data + indl, size() - indl, tmp->data + indf);
-      detach_buffer(dbuf);
-      dbuf = tmp.release();
+      copy_shared_n(dbuf()->data + indl, size() - indl, tmp->data + indf);
+      auxiliary::unshare_counter::record(new_size);
+      detach_buffer(dbuf());
+      state.set_dynamic(tmp.release(), new_size);
     } else {
       iterator first_nc = begin() + indf, last_nc = begin() + indl;
 
-      while (last_nc != end()) {
-        std::iter_swap(first_nc++, last_nc++);
+      if constexpr (RELOCATABLE) {
+        std::destroy(first_nc, last_nc);
+        std::memmove(as_bytes(first_nc), as_bytes(last_nc), (size() - indl) * sizeof(T));
+      } else {
+        std::destroy(std::move(last_nc, end(), first_nc), end());
       }
-      std::destroy(first_nc, last_nc);
     }
-    info.set_size(new_size);
+    state.set_size(new_size);
     return begin() + indf;
   }
 
@@ -451,32 +870,90 @@ public:
 
   /*** End of element delete methods ***/
 
+private:
+  // fill(pointer, count) doesn't read from the vector, so the buffer may grow in place beforehand
+  template <typename Fill>
+  void resize_with(std::size_t new_size, Fill fill) /* strong */ {
+    if (new_size < size()) {
+      erase(std::as_const(*this).begin() + new_size, std::as_const(*this).end());
+    } else if (new_size > size()) {
+      std::size_t count = new_size - size();
+
+      reserve(grown_capacity(new_size));
+      insert_n_shifting(size(), count, [&](pointer dest) { fill(dest, count); });
+      state.set_size(new_size);
+    }
+  }
+
+public:
+  void resize(std::size_t new_size) /* strong */ {
+    resize_with(new_size, [](pointer dest, std::size_t count) { std::uninitialized_value_construct_n(dest, count); });
+  }
+
+  void resize(std::size_t new_size, const value_type& elem) /* strong */ {
+    if (new_size < size()) {
+      erase(std::as_const(*this).begin() + new_size, std::as_const(*this).end());
+    } else if (new_size > size()) {
+      insert(std::as_const(*this).end(), new_size - size(), elem);
+    }
+  }
+
+  // new elements are default-initialized, i.e. left indeterminate for trivial types
+  void resize_for_overwrite(std::size_t new_size) /* strong */ {
+    resize_with(new_size, [](pointer dest, std::size_t count) {
+      std::uninitialized_default_construct_n(dest, count);
+    });
+  }
+
   void shrink_to_fit() {
     if (size() < capacity()) {
       forced_update_to_capacity(size());
     }
   }
 
+#ifdef SOCOW_VECTOR_HAS_MMAP
+  /*** Files ***/
+  void save_to_file(const char* path) const
+    requires (std::is_trivially_copyable_v<T>)
+  {
+    auxiliary::write_mapped_file(path, begin(), sizeof(T), size());
+  }
+
+  // the elements stay in the page cache and are shared with other processes mapping the file
+  static socow_vector map_from_file(const char* path, socow_map_mode mode = socow_map_mode::read_only)
+    requires (std::is_trivially_copyable_v<T> && std::is_same_v<Allocator, mapped_allocator<T>>)
+  {
+    auxiliary::mapped_data mapped = auxiliary::map_file(path, sizeof(T), sizeof(buffer), mode);
+    socow_vector res;
+
+    res.state.set_dynamic(
+        buffer::construct(mapped.data - sizeof(buffer), Allocator(mapped.mapping), mapped.count),
+        mapped.count
+    );
+    if (mapped.count <= SMALL_SIZE) {
+      res.forced_update_to_capacity(mapped.count);
+    }
+    return res;
+  }
+#endif
+
   /*** Cleanup methods ***/
   void clear() noexcept {
     if (is_shared()) {
-      dbuf->share_count--;
-      info.reset();
+      detach_buffer(dbuf());
+      state.reset();
     } else {
       std::destroy_n(begin(), size());
-      info.set_size(0);
+      state.set_size(0);
     }
   }
 
 private:
   void destruct() noexcept {
-    if (is_shared()) {
-      dbuf->share_count--;
+    if (state.is_dynamic()) {
+      detach_buffer(dbuf());
     } else {
-      std::destroy_n(begin(), size());
-      if (info.is_dynamic()) {
-        buffer::deallocate(dbuf);
-      }
+      std::destroy_n(sbuf(), size());
     }
   }
 
@@ -487,3 +964,31 @@ public:
 
   /*** End of cleanup methods ***/
 };
+
+namespace pmr {
+template <
+    typename T,
+    std::size_t SMALL_SIZE,
+    typename Growth = growth_policy::doubling,
+    typename ShareCount = share_count_policy::single_threaded>
+using socow_vector = ::socow_vector<T, SMALL_SIZE, Growth, ShareCount, std::pmr::polymorphic_allocator<T>>;
+} // namespace pmr
+
+// socow_vector that takes a single word when empty or dynamic, see layout_policy::compact
+template <
+    typename T,
+    std::size_t SMALL_SIZE,
+    typename Growth = growth_policy::doubling,
+    typename ShareCount = share_count_policy::single_threaded,
+    typename Allocator = std::allocator<T>>
+using compact_socow_vector = socow_vector<T, SMALL_SIZE, Growth, ShareCount, Allocator, layout_policy::compact>;
+
+#ifdef SOCOW_VECTOR_HAS_MMAP
+// socow_vector whose buffer may be a mapped file, see map_from_file
+template <
+    typename T,
+    std::size_t SMALL_SIZE,
+    typename Growth = growth_policy::doubling,
+    typename ShareCount = share_count_policy::single_threaded>
+using mapped_socow_vector = socow_vector<T, SMALL_SIZE, Growth, ShareCount, mapped_allocator<T>>;
+#endif
@@ -0,0 +1,320 @@
+#ifdef __DEFINETELY_UNDEFINED_MACRO
+#define _main main
+#endif
+
+#define SOCOW_VECTOR_COUNT_UNSHARES
+
+#include "../../common/test.h"
+
+#include "large-copy.h"
+#include "segmented-socow-vector.h"
+#include "socow-soa.h"
+#include "socow-vector-bytes.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+void test_segmented_chunk_unshare() {
+  segmented_socow_vector<int, 2, 4> a;
+
+  for (int i = 0; i < 12; i++) {
+    a.push_back(i);
+  }
+
+  segmented_socow_vector<int, 2, 4> b = a;
+  const int* first_chunk = &std::as_const(a)[0];
+  const int* third_chunk = &std::as_const(a)[8];
+
+  reset_socow_unshare_stats();
+  b[5] = -5;
+
+  _iseq(std::as_const(a)[5], 5);
+  _iseq(std::as_const(b)[5], -5);
+  // the directory of 3 chunks and the second chunk are copied
+  _iseq(get_socow_unshare_stats().copies, 2u);
+  _iseq(get_socow_unshare_stats().elements, 3u + 4u);
+  _isneq(&std::as_const(b)[5], &std::as_const(a)[5]);
+  _iseq(&std::as_const(b)[0], first_chunk);
+  _iseq(&std::as_const(b)[8], third_chunk);
+
+  reset_socow_unshare_stats();
+  b[6] = -6;
+  _iseq(get_socow_unshare_stats().copies, 0u);
+}
+
+void test_segmented_iterator() {
+  using vector = segmented_socow_vector<int, 2, 4>;
+  static_assert(std::random_access_iterator<vector::const_iterator>);
+  static_assert(std::is_same_v<
+                std::iterator_traits<vector::const_iterator>::iterator_category,
+                std::random_access_iterator_tag>);
+
+  vector a;
+  for (int i = 0; i < 10; i++) {
+    a.push_back(i);
+  }
+
+  _iseq(a.end() - a.begin(), 10);
+  _iseq(*(a.begin() + 7), 7);
+  _iseq(a.begin()[9], 9);
+  _check(std::is_sorted(a.begin(), a.end()));
+}
+
+// throws when made from a negative number
+struct picky {
+  int value;
+
+  picky(int value)
+      : value(value) {
+    if (value < 0) {
+      throw std::invalid_argument("negative");
+    }
+  }
+};
+
+void test_soa_rows() {
+  using soa = socow_soa<2, int, std::string>;
+#ifdef __cpp_lib_ranges_zip
+  static_assert(std::random_access_iterator<soa::const_iterator>);
+#endif
+  // the rows are tuples of references, so legacy algorithms only get an input iterator
+  static_assert(std::is_same_v<
+                std::iterator_traits<soa::const_iterator>::iterator_category,
+                std::input_iterator_tag>);
+
+  soa a;
+  for (int i = 0; i < 5; i++) {
+    a.emplace_back(i, std::to_string(i));
+  }
+  a.push_back({5, "5"});
+
+  _iseq(a.size(), 6u);
+  _iseq(std::get<1>(a[3]), "3");
+  _iseq(std::get<0>(a.back()), 5);
+  _iseq(a.end() - a.begin(), 6);
+
+  int sum = 0;
+  for (auto [number, name] : a) {
+    _iseq(name, std::to_string(number));
+    sum += number;
+  }
+  _iseq(sum, 15);
+}
+
+void test_soa_column_unshare() {
+  socow_soa<2, int, int> a;
+  for (int i = 0; i < 8; i++) {
+    a.emplace_back(i, -i);
+  }
+
+  socow_soa<2, int, int> b = a;
+  b.mutate<1>()[0] = 100;
+
+  _iseq(b.cview<0>().data(), a.cview<0>().data());
+  _isneq(b.cview<1>().data(), a.cview<1>().data());
+  _iseq(std::get<1>(std::as_const(a)[0]), 0);
+  _iseq(std::get<1>(std::as_const(b)[0]), 100);
+}
+
+void test_soa_emplace_rollback() {
+  socow_soa<2, int, std::string, picky> a;
+  a.emplace_back(1, "one", 1);
+
+  bool thrown = false;
+  try {
+    a.emplace_back(2, "two", -2);
+  } catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+
+  _check(thrown);
+  // the columns pushed before the throw are rolled back
+  _iseq(a.size(), 1u);
+  _iseq(a.column<0>().size(), 1u);
+  _iseq(a.column<1>().size(), 1u);
+  _iseq(a.column<2>().size(), 1u);
+  _iseq(std::get<1>(a.back()), "one");
+}
+
+// holds a double, so a NaN point isn't equal to itself
+struct point {
+  double x;
+
+  bool operator==(const point&) const = default;
+};
+
+void test_shared_buffer_equality() {
+  static_assert(has_reflexive_equality_v<int>);
+  static_assert(has_reflexive_equality_v<std::string>);
+  static_assert(!has_reflexive_equality_v<double>);
+  static_assert(!has_reflexive_equality_v<point>);
+
+  socow_vector<point, 1> a;
+  a.push_back({1});
+  a.push_back({std::numeric_limits<double>::quiet_NaN()});
+
+  socow_vector<point, 1> b = a;
+  _check(!(a == b));
+
+  socow_vector<int, 1> c;
+  c.push_back(1);
+  c.push_back(2);
+
+  socow_vector<int, 1> d = c;
+  _check(c == d);
+  _check((c <=> d) == 0);
+}
+
+void test_bytes_budget() {
+  using split_chars = socow_vector_bytes<char, 200>;
+  using compact_chars = socow_vector_bytes<
+      char,
+      200,
+      growth_policy::doubling,
+      share_count_policy::single_threaded,
+      std::allocator<char>,
+      layout_policy::compact>;
+  using compact_ints = socow_vector_bytes<
+      int,
+      64,
+      growth_policy::doubling,
+      share_count_policy::single_threaded,
+      std::allocator<int>,
+      layout_policy::compact>;
+
+  static_assert(sizeof(split_chars) <= 200);
+  static_assert(sizeof(socow_vector<char, socow_layout<split_chars>::small_size + 1>) > 200);
+  // compact keeps the static size in 7 bits
+  static_assert(socow_layout<compact_chars>::small_size == 127);
+  static_assert(sizeof(compact_ints) <= 64);
+  static_assert(socow_layout<compact_ints>::small_size == 15);
+  _check(socow_layout<split_chars>::small_size > 127);
+}
+
+void test_large_copy() {
+  socow_large_copy_config old_config = get_socow_large_copy_config();
+  set_socow_large_copy_config({.threshold = 4096, .threads = 4});
+
+  // small vectors stay below the threshold, the large one is split between the workers
+  for (std::size_t n : {10, 1000, 100001}) {
+    socow_vector<int, 3> a;
+
+    for (std::size_t i = 0; i < n; i++) {
+      a.push_back(static_cast<int>(i));
+    }
+
+    socow_vector<int, 3> b = a;
+    b[0] = -1;
+
+    _iseq(std::as_const(a)[0], 0);
+    _iseq(b.size(), n);
+    bool same = true;
+    for (std::size_t i = 1; i < n; i++) {
+      same = same && std::as_const(b)[i] == static_cast<int>(i);
+    }
+    _check(same);
+  }
+
+  set_socow_large_copy_config(old_config);
+}
+
+#ifdef SOCOW_VECTOR_HAS_MMAP
+std::string mapped_test_path() {
+  return (std::filesystem::temp_directory_path() / "socow-vector-test.bin").string();
+}
+
+mapped_socow_vector<int, 2> saved_numbers(std::size_t n) {
+  mapped_socow_vector<int, 2> a;
+
+  for (std::size_t i = 0; i < n; i++) {
+    a.push_back(static_cast<int>(i * i));
+  }
+  a.save_to_file(mapped_test_path().c_str());
+  return a;
+}
+
+void test_mapped_read_only() {
+  mapped_socow_vector<int, 2> saved = saved_numbers(1000);
+  auto a = mapped_socow_vector<int, 2>::map_from_file(mapped_test_path().c_str());
+
+  _iseq(a.size(), 1000u);
+  _check(std::ranges::equal(std::as_const(a), std::as_const(saved)));
+
+  // growth copies the pages to the heap instead of moving out of them
+  reset_socow_unshare_stats();
+  a.reserve(5000);
+  _iseq(get_socow_unshare_stats().copies, 1u);
+  _iseq(get_socow_unshare_stats().elements, 1000u);
+
+  a[0] = -1;
+  auto b = mapped_socow_vector<int, 2>::map_from_file(mapped_test_path().c_str());
+  _iseq(std::as_const(b)[0], 0);
+  _iseq(std::as_const(b)[999], 999 * 999);
+
+  // a mapping small enough for the static buffer is copied into it
+  saved_numbers(2);
+  reset_socow_unshare_stats();
+  auto c = mapped_socow_vector<int, 2>::map_from_file(mapped_test_path().c_str());
+  _iseq(c.size(), 2u);
+  _iseq(std::as_const(c)[1], 1);
+  _iseq(get_socow_unshare_stats().copies, 1u);
+
+  std::filesystem::remove(mapped_test_path());
+}
+
+void test_mapped_copy_on_write() {
+  saved_numbers(1000);
+  auto a = mapped_socow_vector<int, 2>::map_from_file(mapped_test_path().c_str(), socow_map_mode::copy_on_write);
+  const int* data = std::as_const(a).begin();
+
+  reset_socow_unshare_stats();
+  a[10] = -10;
+  _iseq(std::as_const(a).begin(), data);
+  _iseq(get_socow_unshare_stats().copies, 0u);
+  _iseq(std::as_const(a)[10], -10);
+
+  // private pages never reach the file
+  auto b = mapped_socow_vector<int, 2>::map_from_file(mapped_test_path().c_str());
+  _iseq(std::as_const(b)[10], 100);
+
+  std::filesystem::remove(mapped_test_path());
+}
+
+void test_mapped_truncated() {
+  saved_numbers(1000);
+  std::filesystem::resize_file(mapped_test_path(), std::filesystem::file_size(mapped_test_path()) - sizeof(int));
+
+  bool thrown = false;
+  try {
+    mapped_socow_vector<int, 2>::map_from_file(mapped_test_path().c_str());
+  } catch (const std::system_error&) {
+    thrown = true;
+  }
+  _check(thrown);
+
+  std::filesystem::remove(mapped_test_path());
+}
+#endif
+
+int _main() {
+  _run(test_segmented_chunk_unshare);
+  _run(test_segmented_iterator);
+  _run(test_soa_rows);
+  _run(test_soa_column_unshare);
+  _run(test_soa_emplace_rollback);
+  _run(test_shared_buffer_equality);
+  _run(test_bytes_budget);
+  _run(test_large_copy);
+#ifdef SOCOW_VECTOR_HAS_MMAP
+  _run(test_mapped_read_only);
+  _run(test_mapped_copy_on_write);
+  _run(test_mapped_truncated);
+#endif
+  return 0;
+}
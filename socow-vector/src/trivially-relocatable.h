@@ -0,0 +1,24 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+
+// T is trivially relocatable if moving an object to new storage and destroying the original
+// is equivalent to copying its bytes. Trivially copyable types are, user types opt in by specializing.
+template <typename T>
+struct is_trivially_relocatable : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+template <typename T, typename Deleter>
+struct is_trivially_relocatable<std::unique_ptr<T, Deleter>> : is_trivially_relocatable<Deleter> {};
+
+template <typename T>
+struct is_trivially_relocatable<std::default_delete<T>> : std::true_type {};
+
+template <typename T>
+struct is_trivially_relocatable<std::shared_ptr<T>> : std::true_type {};
+
+template <typename T>
+struct is_trivially_relocatable<std::weak_ptr<T>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
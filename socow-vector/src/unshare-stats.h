@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Counters of deep copies made by socow_vector when a shared buffer is unshared.
+// Collected only if SOCOW_VECTOR_COUNT_UNSHARES is defined, otherwise recording is a no-op.
+struct socow_unshare_stats {
+  std::size_t copies = 0;
+  std::size_t elements = 0;
+};
+
+namespace auxiliary {
+class unshare_counter {
+private:
+#ifdef SOCOW_VECTOR_COUNT_UNSHARES
+  inline static std::atomic<std::size_t> copies = 0;
+  inline static std::atomic<std::size_t> elements = 0;
+#endif
+
+public:
+  static void record([[maybe_unused]] std::size_t count) noexcept {
+#ifdef SOCOW_VECTOR_COUNT_UNSHARES
+    copies.fetch_add(1, std::memory_order_relaxed);
+    elements.fetch_add(count, std::memory_order_relaxed);
+#endif
+  }
+
+  static socow_unshare_stats snapshot() noexcept {
+#ifdef SOCOW_VECTOR_COUNT_UNSHARES
+    return {copies.load(std::memory_order_relaxed), elements.load(std::memory_order_relaxed)};
+#else
+    return {};
+#endif
+  }
+
+  static void reset() noexcept {
+#ifdef SOCOW_VECTOR_COUNT_UNSHARES
+    copies.store(0, std::memory_order_relaxed);
+    elements.store(0, std::memory_order_relaxed);
+#endif
+  }
+};
+} // namespace auxiliary
+
+inline socow_unshare_stats get_socow_unshare_stats() noexcept {
+  return auxiliary::unshare_counter::snapshot();
+}
+
+inline void reset_socow_unshare_stats() noexcept {
+  auxiliary::unshare_counter::reset();
+}